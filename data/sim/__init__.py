@@ -3,6 +3,6 @@
 """
 
 from sim.program_input import ProgramInput
-from sim.simulator import Simulator, ContactSearchResult, SimulationResult
+from sim.simulator import Simulator, ContactSearchResult, SimulationResult, BenchmarkResult
 from sim.world_defaults import default_world_properties
 
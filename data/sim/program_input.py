@@ -17,6 +17,18 @@ from sim.dynamics import WorldProperties, prepare_world_properties
 class ProgramMode(IntEnum):
     Simulate = 1
     FindContactProb = 2
+    Benchmark = 3
+
+
+class InfectionEngine(IntEnum):
+    PerCarrier = 0
+    Aggregate = 1
+
+
+class ParallelMode(IntEnum):
+    Auto = 0
+    Carriers = 1
+    Runs = 2
 
 
 @dataclass
@@ -24,6 +36,15 @@ class ProgramOptions:
     full_history: bool
     expensive_stats: bool
     mode: ProgramMode
+    immunity_bitsets: bool = False
+    parallelism: ParallelMode = ParallelMode.Auto
+    engine: InfectionEngine = InfectionEngine.PerCarrier
+    cache_dir: str = ""
+    prefetch_batch: int = 16
+    threads: int = 0
+    serial_threshold: int = -1
+    lockstep: bool = False
+    sparse_population: bool = False
 
 
 @dataclass
@@ -46,6 +67,7 @@ class ProgramInput:
     infected_history: Optional[Dict[str, StateEstimates]] = None
     vax_history: Optional[Dict[str, StateVaccineHistory]] = None
     variant_history: Optional[Dict[str, List[Dict]]] = None
+    seed: Optional[int] = None
 
     def to_str(self) -> str:
         if self.options is None:
@@ -67,6 +89,8 @@ class ProgramInput:
             "state_info": _prep_state_info(self.state_info),
             "variant_history": _prep_variant_history(self.variant_history)
         }
+        if self.seed is not None:
+            output["seed"] = self.seed
         return json.dumps(output, indent=2)
 
 
@@ -1,5 +1,6 @@
 from __future__ import annotations
 
+import dataclasses
 import json
 import hashlib
 import os
@@ -121,6 +122,14 @@ class ContactSearchResult:
     stdevs: List[float]
 
 
+@dataclass
+class BenchmarkResult:
+    batch_sizes: List[int]
+    seconds: List[float]
+    best: int
+    serial_threshold: int
+
+
 @dataclass
 class SimulationResult:
     run_time: float
@@ -288,6 +297,29 @@ class Simulator:
 
         return search_result
 
+    def benchmark(self) -> BenchmarkResult:
+        """
+        Times the simulation at a range of prefetch batch sizes, the best of which can be given to the simulator as
+        the prefetch_batch option. Also reports the serial threshold the simulator calibrated, which can be given as
+        the serial_threshold option.
+        """
+        # Everything but the mode is kept, so that the benchmark measures the configuration being tuned
+        original_options = self.input_data.options
+        base_options = original_options or ProgramOptions(False, False, ProgramMode.Simulate)
+        self.input_data.options = dataclasses.replace(base_options, mode=ProgramMode.Benchmark)
+        try:
+            self._write_input_text()
+
+            command = [settings.binary_path, self.input_file]
+            process = subprocess.Popen(command)
+            process.communicate()
+
+            result = BenchmarkResult(**self._load_results())
+        finally:
+            self.input_data.options = original_options
+            self._clear_cache_info()
+        return result
+
     def _load_simulation_results(self, raw_data) -> Dict[str, List[List[StepResult]]]:
         results = {}
         for row in raw_data:
@@ -318,5 +350,5 @@ class Simulator:
         if self.input_data.options.mode == ProgramMode.Simulate:
             return self._load_simulation_results(raw_data)
 
-        if self.input_data.options.mode == ProgramMode.FindContactProb:
+        if self.input_data.options.mode in (ProgramMode.FindContactProb, ProgramMode.Benchmark):
             return raw_data
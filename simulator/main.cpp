@@ -1,3 +1,4 @@
+#include <array>
 #include <cstdio>
 #include <iostream>
 #include <vector>
@@ -7,71 +8,69 @@
 #include <memory>
 #include "date.h"
 
-#include <omp.h>
-
 #include "sim/data.hpp"
-#include "sim/variant_probabilities.hpp"
+#include "sim/plan.hpp"
 #include "sim/simulators.hpp"
 #include "sim/contact_prob.hpp"
+#include "sim/lockstep.hpp"
+#include "sim/parallelism.hpp"
 
-using sim::VariantDictionary;
-
-void Simulate(const sim::data::ProgramInput &input, std::shared_ptr<const sim::VariantDictionary> variants);
-void FindContactProb(const sim::data::ProgramInput &input, std::shared_ptr<const sim::VariantDictionary> variants);
+void Simulate(const sim::data::ProgramInput &input, std::shared_ptr<const sim::SimulationPlan> plan);
+void FindContactProb(const sim::data::ProgramInput &input, std::shared_ptr<const sim::SimulationPlan> plan);
+void Benchmark(const sim::data::ProgramInput &input, std::shared_ptr<const sim::SimulationPlan> plan);
+void PrintSchedule(const sim::ScheduleStats &schedule, size_t threshold);
 
 int main(int argc, char **argv) {
-    using sim::Variant;
 
     std::string data_file = (argc > 1) ? argv[1] : "/tmp/input_data.json";
     printf("Covid Simulation\n");
     printf(" * input file: %s\n", data_file.c_str());
 
     auto input = sim::data::LoadData(data_file);
-    auto variants = std::make_shared<sim::VariantDictionary>();
-    (*variants)[Variant::Alpha] = std::make_unique<sim::VariantProbabilities>(input.world_properties.alpha, Variant::Alpha);
-    (*variants)[Variant::Delta] = std::make_unique<sim::VariantProbabilities>(input.world_properties.delta, Variant::Delta);
+    printf(" * seed: %llu\n", static_cast<unsigned long long>(input.seed));
+    auto plan = sim::CompilePlan(input);
 
     if (input.options.mode == sim::data::ProgramMode::Simulate) {
-        Simulate(input, variants);
+        Simulate(input, plan);
     } else if (input.options.mode == sim::data::ProgramMode::FindContactProb) {
-        FindContactProb(input, variants);
+        FindContactProb(input, plan);
+    } else if (input.options.mode == sim::data::ProgramMode::Benchmark) {
+        Benchmark(input, plan);
     }
 
     return 0;
 }
 
-void FindContactProb(const sim::data::ProgramInput &input, std::shared_ptr<const sim::VariantDictionary> variants) {
-    sim::ContactProbabilitySearch search(input, variants);
+void FindContactProb(const sim::data::ProgramInput &input, std::shared_ptr<const sim::SimulationPlan> plan) {
+    sim::ContactProbabilitySearch search(input, plan);
     sim::ContactSearchResultSet results;
     printf(" * finding contact probabilities\n");
 
 //    PerfTimer timer;
 //    timer.Start();
-    auto working_day = input.start_day;
-    while (working_day <= input.end_day) {
+    std::vector<int> days;
+    for (auto working_day = input.start_day; working_day <= input.end_day;
+         working_day += date::days{std::max(1, input.contact_day_interval)}) {
+        days.push_back(sim::data::ToReferenceDate(working_day));
+    }
 
-        date::year_month_day ymd = working_day;
+    auto found = search.FindContactProbabilities(days);
+    for (size_t i = 0; i < days.size(); ++i) {
+        date::year_month_day ymd = sim::data::ToSysDays(days[i]);
         printf(" * contact prob for %i-%u-%u\n",
                (int)ymd.year(),
                ymd.month().operator unsigned int(),
                ymd.day().operator unsigned int());
 
-        auto ref_day = sim::data::ToReferenceDate(working_day);
-        auto result = search.FindContactProbability(ref_day);
-        results.days.push_back(ref_day);
-        results.probabilities.push_back(result.prob);
-        results.stdevs.push_back(result.stdev);
+        results.days.push_back(days[i]);
+        results.probabilities.push_back(found[i].prob);
+        results.stdevs.push_back(found[i].stdev);
 
-        printf(" > result (%0.2f)\n", result.prob);
-
-        working_day += date::days{std::max(1, input.contact_day_interval)};
+        printf(" > result (%0.2f)\n", found[i].prob);
     }
 
 //    timer.Stop();
-//    printf("[time] simulation = %0.4f s\n", static_cast<double>(search.sim_timer.Elapsed()) / 1.0e6);
-//    printf("[time] copy       = %0.4f s\n", static_cast<double>(search.copy_timer.Elapsed()) / 1.0e6);
-//    printf("[time] vaccine    = %0.4f s\n", static_cast<double>(search.vax_timer.Elapsed()) / 1.0e6);
-//    printf("[time] total      = %0.4f s\n", static_cast<double>(search.total_timer.Elapsed()) / 1.0e6);
+//    printf("[time] search     = %0.4f s\n", static_cast<double>(search.total_timer.Elapsed()) / 1.0e6);
 //    printf("[time] all total  = %0.4f s\n", static_cast<double>(timer.Elapsed()) / 1.0e6);
 
     nlohmann::json encoded = results;
@@ -80,67 +79,133 @@ void FindContactProb(const sim::data::ProgramInput &input, std::shared_ptr<const
     output.close();
 }
 
-void Simulate(const sim::data::ProgramInput &input, std::shared_ptr<const sim::VariantDictionary> variants) {
-    auto state_info = input.state_info.at(input.state);
-    sim::Simulator simulator(input.options, variants);
-    sim::Population reference_population(state_info.population, input.population_scale, state_info.ages);
-    sim::Population population(state_info.population, input.population_scale, state_info.ages);
-    printf(" * starting simulation (pop=%i at 1:%i scale)\n", reference_population.people.size(), input.population_scale);
+void Simulate(const sim::data::ProgramInput &input, std::shared_ptr<const sim::SimulationPlan> plan) {
+    const auto &state_info = plan->state_info;
+    sim::Simulator simulator(plan);
+    const bool sparse = input.options.sparse_population;
+    sim::Population reference_population(state_info.population, input.population_scale, state_info.ages, sparse);
+    printf(" * starting simulation (pop=%zu at 1:%i scale)\n", reference_population.people.size(), input.population_scale);
 
     // Initialize the population from the beginning
     PerfTimer timer;
     timer.Start();
-    auto init_result = simulator.InitializePopulation(reference_population,
-                                                      input.infected_history.at(input.state),
-                                                      input.vax_history.at(input.state),
-                                                      input.variant_history.at(input.state),
-                                                      input.start_day);
+    auto init_result = simulator.InitializePopulation(reference_population, input.start_day);
     timer.Stop();
     printf(" * initialization took %0.4f s\n", static_cast<double>(timer.Elapsed()) / 1.0e6);
 
-    timer.Reset();
-    timer.Start();
-    std::vector<sim::data::StateResult> results;
-    for (int run = 0; run < input.run_count; ++run) {
-        population.CopyFrom(reference_population);
-        results.emplace_back();
-        results.back().name = input.state;
+    // Lockstep batches split each day over the threads, the same as the carriers mode
+    const bool lockstep = input.options.lockstep && input.options.engine == sim::data::InfectionEngine::PerCarrier;
+    auto parallelism = lockstep ? sim::data::ParallelMode::Carriers
+                                : sim::ChooseParallelism(input.options.parallelism,
+                                                         reference_population.people.size(), input.run_count,
+                                                         static_cast<int>(simulator.Pool().Size()));
+    printf(" * parallel over %s%s\n", sim::ToString(parallelism), lockstep ? ", runs in lockstep batches" : "");
+
+    auto begin_result = [&](sim::data::StateResult &result) {
+        result.name = input.state;
 
         if (!init_result.empty()) {
             // If the option for exporting the full history is on, we copy the data from the initialization phase into
             // the results storage
             for (const auto& r : init_result) {
-                results.back().results.push_back(r);
+                result.results.push_back(r);
             }
         } else {
             // If the option for exporting the full history is off, we at least need to export the day before the first
             // simulation day so that differentiated statistics can be computed
-            results.back().results.push_back(simulator.GetDailySummary(population, input.options.expensive_stats));
+            result.results.push_back(simulator.GetDailySummary(reference_population, input.options.expensive_stats));
         }
+    };
+
+    auto run_one = [&](sim::Simulator &sim, sim::Population &pop, int run, sim::data::StateResult &result) {
+        pop.CopyFrom(reference_population);
+        sim.SetRun(run);
+        begin_result(result);
 
         // Setting the contact probability
-        simulator.SetProbabilities(input.contact_probability);
+        sim.SetProbabilities(input.contact_probability);
 
         auto today = input.start_day;
         while (today < input.end_day) {
             // Add the newly vaccinated
-            if (!input.vax_history.empty()) simulator.ApplyVaccines(population,
-                                                                     input.vax_history.at(input.state));
+            sim.ApplyVaccines(pop);
 
             // Simulate the day's events
-            results.back().results.push_back(simulator.SimulateDay(population));
+            result.results.push_back(sim.SimulateDay(pop));
 
             // Increment the clock
             today += date::days{1};
         }
+    };
+
+    timer.Reset();
+    timer.Start();
+    std::vector<sim::data::StateResult> results(input.run_count);
+    sim::ScheduleStats schedule = simulator.Schedule();
+    size_t serial_threshold = simulator.SerialThreshold();
+    if (lockstep) {
+        // Batches of kLanes runs branch off the reference population together, run first + l in lane l, which gives
+        // the same results as simulating them one at a time
+        constexpr auto lanes = static_cast<int>(sim::LockstepSimulator::kLanes);
+        sim::LockstepSimulator batch(plan, simulator.Pool());
+        const std::vector<double> probabilities(lanes, input.contact_probability);
+        std::array<sim::DailySummary, sim::LockstepSimulator::kLanes> summaries{};
+        for (int first = 0; first < input.run_count; first += lanes) {
+            auto count = static_cast<size_t>(std::min(lanes, input.run_count - first));
+            batch.Start(reference_population, {probabilities.data(), count}, static_cast<uint32_t>(first));
+            for (size_t l = 0; l < count; ++l) {
+                begin_result(results[first + l]);
+            }
+
+            for (auto today = input.start_day; today < input.end_day; today += date::days{1}) {
+                batch.ApplyVaccines();
+                batch.SimulateDay(summaries, input.options.expensive_stats);
+                for (size_t l = 0; l < count; ++l) {
+                    results[first + l].results.push_back(summaries[l]);
+                }
+            }
+        }
+    } else if (parallelism == sim::data::ParallelMode::Runs) {
+        // Each thread of the pool owns a simulator and a population, made the first time it picks up a run. The days
+        // inside each run may still be split over threads which are idle. Random streams are keyed by run, so the
+        // results match the serial order.
+        auto &pool = simulator.Pool();
+        std::vector<std::unique_ptr<sim::Simulator>> local_simulators(pool.Size());
+        std::vector<std::unique_ptr<sim::Population>> local_populations(pool.Size());
+        pool.ParallelFor(0, static_cast<size_t>(input.run_count), 1, [&](size_t first, size_t last) {
+            auto worker = pool.WorkerIndex();
+            if (!local_simulators[worker]) {
+                local_simulators[worker] = std::make_unique<sim::Simulator>(simulator);
+                local_populations[worker] = std::make_unique<sim::Population>(reference_population);
+            }
+            for (auto run = first; run < last; ++run) {
+                run_one(*local_simulators[worker], *local_populations[worker], static_cast<int>(run), results[run]);
+            }
+        });
+
+        // The replicas each keep their own threshold, and any one of them is representative
+        for (const auto &local : local_simulators) {
+            if (!local) continue;
+            serial_threshold = local->SerialThreshold();
+            schedule.serial_days += local->Schedule().serial_days - simulator.Schedule().serial_days;
+            schedule.parallel_days += local->Schedule().parallel_days - simulator.Schedule().parallel_days;
+        }
+    } else {
+        // The runs take turns on a single working population
+        sim::Population population(state_info.population, input.population_scale, state_info.ages, sparse);
+        for (int run = 0; run < input.run_count; ++run) {
+            run_one(simulator, population, run, results[run]);
+        }
+        schedule = simulator.Schedule();
+        serial_threshold = simulator.SerialThreshold();
     }
 
     timer.Stop();
     printf(" * %i runs in %0.4f s\n", input.run_count, static_cast<double>(timer.Elapsed()) / 1.0e6);
+    PrintSchedule(schedule, serial_threshold);
 
 #ifdef PERF_MEASURE
     printf("[time] loop   = %0.4f s\n", static_cast<double>(simulator.loop_timer.Elapsed()) / 1.0e6);
-    printf("[time] alloc  = %0.4f s\n", static_cast<double>(simulator.alloc) / 1.0e6);
     printf("[time] remove = %0.4f s\n", static_cast<double>(simulator.remove_timer.Elapsed()) / 1.0e6);
     printf("[time] infect = %0.4f s\n", static_cast<double>(simulator.infect_timer.Elapsed()) / 1.0e6);
 #endif
@@ -149,4 +214,92 @@ void Simulate(const sim::data::ProgramInput &input, std::shared_ptr<const sim::V
     std::ofstream output{input.output_file.c_str()};
     output << encoded << std::endl;
     output.close();
-}
\ No newline at end of file
+}
+
+void Benchmark(const sim::data::ProgramInput &input, std::shared_ptr<const sim::SimulationPlan> plan) {
+    // Times the simulation of the input's days and runs at each prefetch batch size, which only changes the speed and
+    // never the results, so that the best size for this machine and population scale can be put in the options
+    const auto &state_info = plan->state_info;
+    sim::Simulator simulator(plan);
+    const bool sparse = input.options.sparse_population;
+    sim::Population reference_population(state_info.population, input.population_scale, state_info.ages, sparse);
+    sim::Population population(state_info.population, input.population_scale, state_info.ages, sparse);
+    printf(" * benchmarking (pop=%zu at 1:%i scale)\n", reference_population.people.size(), input.population_scale);
+    simulator.InitializePopulation(reference_population, input.start_day);
+    simulator.SetProbabilities(input.contact_probability);
+
+    auto simulate_runs = [&]() {
+        for (int run = 0; run < input.run_count; ++run) {
+            population.CopyFrom(reference_population);
+            simulator.SetRun(run);
+            for (auto today = input.start_day; today < input.end_day; today += date::days{1}) {
+                simulator.ApplyVaccines(population);
+                simulator.SimulateDay(population);
+            }
+        }
+    };
+
+    // An untimed pass first, so that growing the simulator's buffers isn't counted against the first size
+    simulate_runs();
+
+    std::vector<int> batch_sizes{1, 2, 4, 8, 16, 32, 64, 128, 256};
+    std::vector<double> seconds;
+    for (int batch : batch_sizes) {
+        simulator.SetPrefetchBatch(batch);
+
+        PerfTimer timer;
+        timer.Start();
+        simulate_runs();
+        timer.Stop();
+
+        seconds.push_back(static_cast<double>(timer.Elapsed()) / 1.0e6);
+        printf(" * prefetch batch %3i: %0.4f s\n", batch, seconds.back());
+    }
+
+    auto best = batch_sizes[std::min_element(seconds.begin(), seconds.end()) - seconds.begin()];
+    printf(" > best prefetch batch (%i)\n", best);
+    PrintSchedule(simulator.Schedule(), simulator.SerialThreshold());
+
+    nlohmann::json encoded = {{"batch_sizes", batch_sizes},
+                              {"seconds", seconds},
+                              {"best", best},
+                              {"serial_threshold", simulator.SerialThreshold()}};
+
+    // With the lockstep option, also times the same runs simulated kLanes at a time by a LockstepSimulator, which
+    // gives the same results, against the best of the runs one by one
+    if (input.options.lockstep) {
+        sim::LockstepSimulator lockstep(plan, simulator.Pool());
+        const std::vector<double> probabilities(sim::LockstepSimulator::kLanes, input.contact_probability);
+        auto simulate_lockstep = [&]() {
+            for (int run = 0; run < input.run_count; run += static_cast<int>(sim::LockstepSimulator::kLanes)) {
+                auto count = std::min(probabilities.size(), static_cast<size_t>(input.run_count - run));
+                lockstep.Start(reference_population, {probabilities.data(), count}, static_cast<uint32_t>(run));
+                for (auto today = input.start_day; today < input.end_day; today += date::days{1}) {
+                    lockstep.ApplyVaccines();
+                    lockstep.SimulateDay();
+                }
+            }
+        };
+        simulate_lockstep();
+
+        PerfTimer timer;
+        timer.Start();
+        simulate_lockstep();
+        timer.Stop();
+
+        double lockstep_seconds = static_cast<double>(timer.Elapsed()) / 1.0e6;
+        double separate_seconds = *std::min_element(seconds.begin(), seconds.end());
+        printf(" * lockstep: %0.4f s, one by one: %0.4f s (%0.2fx)\n", lockstep_seconds, separate_seconds,
+               separate_seconds / lockstep_seconds);
+        encoded["lockstep_seconds"] = lockstep_seconds;
+        encoded["separate_seconds"] = separate_seconds;
+    }
+    std::ofstream output{input.output_file.c_str()};
+    output << encoded << std::endl;
+    output.close();
+}
+
+void PrintSchedule(const sim::ScheduleStats &schedule, size_t threshold) {
+    printf(" * days run serially: %li, split over threads: %li (serial below %zu carriers)\n", schedule.serial_days,
+           schedule.parallel_days, threshold);
+}
@@ -0,0 +1,52 @@
+#include "alias_table.hpp"
+#include <numeric>
+
+sim::AliasTable::AliasTable(const std::vector<double> &weights) {
+    size_t n = weights.empty() ? 1 : weights.size();
+    threshold_.assign(n, 1.0);
+    alias_.resize(n);
+    std::iota(alias_.begin(), alias_.end(), 0);
+
+    double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if (weights.empty() || total <= 0) return;
+
+    // Scale each weight so the average column holds exactly 1, then pair every underfull column with an overfull
+    // one that donates the remainder
+    std::vector<double> scaled(n);
+    std::vector<size_t> small;
+    std::vector<size_t> large;
+    for (size_t i = 0; i < n; ++i) {
+        scaled[i] = weights[i] * static_cast<double>(n) / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        auto s = small.back();
+        small.pop_back();
+        auto l = large.back();
+
+        threshold_[s] = scaled[s];
+        alias_[s] = static_cast<int>(l);
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // Whatever is left over is full up to rounding error
+    for (auto i : small) threshold_[i] = 1.0;
+    for (auto i : large) threshold_[i] = 1.0;
+}
+
+void sim::AliasTable::Sample(const double *uniforms, int *outcomes, size_t count) const {
+    const double n = static_cast<double>(threshold_.size());
+    const double *threshold = threshold_.data();
+    const int *alias = alias_.data();
+    for (size_t i = 0; i < count; ++i) {
+        double scaled = uniforms[i] * n;
+        auto column = static_cast<int>(scaled);
+        double fraction = scaled - static_cast<double>(column);
+        outcomes[i] = fraction < threshold[column] ? column : alias[column];
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace sim {
+
+    /** @class AliasTable
+     *
+     * @brief Walker/Vose alias table for drawing from a fixed discrete distribution in constant time
+     *
+     * @summary Building the table costs O(n) for n outcomes, after which every draw takes one uniform value, one
+     * multiply and a single table lookup, regardless of the shape of the distribution. The index and the acceptance
+     * test are both taken from the same uniform: its integer part after scaling by n picks a column, and its
+     * fractional part decides between the column and its alias.
+     */
+    class AliasTable {
+    public:
+        AliasTable() = default;
+
+        /** @brief Builds the table from non-negative weights, which don't need to be normalized. Outcome i is drawn
+         * with probability weights[i] / sum(weights).
+         */
+        explicit AliasTable(const std::vector<double> &weights);
+
+        [[nodiscard]] inline size_t size() const { return threshold_.size(); }
+
+        /** @brief Draws an outcome from a uniform value in [0, 1)
+         */
+        [[nodiscard]] inline int Sample(double uniform) const {
+            double scaled = uniform * static_cast<double>(threshold_.size());
+            auto column = static_cast<size_t>(scaled);
+            double fraction = scaled - static_cast<double>(column);
+            return fraction < threshold_[column] ? static_cast<int>(column) : alias_[column];
+        }
+
+        /** @brief Draws one outcome for each of `count` uniform values. The loop has no branches or dependencies
+         * between iterations, so the compiler can vectorize it.
+         */
+        void Sample(const double *uniforms, int *outcomes, size_t count) const;
+
+    private:
+        std::vector<double> threshold_;
+        std::vector<int> alias_;
+    };
+
+}
@@ -1,95 +1,196 @@
 #include "contact_prob.hpp"
+#include "parallelism.hpp"
 
 sim::ContactProbabilitySearch::ContactProbabilitySearch(const sim::data::ProgramInput &input,
-                                                        std::shared_ptr<const sim::VariantDictionary> variants)
-    : input_(input), variants_(variants) {}
+                                                        std::shared_ptr<const SimulationPlan> plan)
+    : input_(input), plan_(plan), simulator_(plan),
+      reference_pop_(plan->state_info.population, plan->population_scale, plan->state_info.ages,
+                     plan->options.sparse_population) {}
 
-sim::ContactResult sim::ContactProbabilitySearch::FindContactProbability(int day) {
-    auto start_date = data::ToSysDays(day);
-    auto state_info = input_.state_info.at(input_.state);
-
-    Simulator simulator(input_.options, variants_);
-    Population ref_pop(state_info.population, input_.population_scale, state_info.ages);
-    Population work_pop = ref_pop;
+std::vector<sim::ContactResult> sim::ContactProbabilitySearch::FindContactProbabilities(const std::vector<int> &days) {
+    total_timer.Start();
 
-    // The starting guess for the contact probability is the value that was supplied
+    auto &pool = simulator_.Pool();
+    int threads = static_cast<int>(pool.Size());
+    auto mode = ChooseParallelism(input_.options.parallelism, reference_pop_.people.size(),
+                                  input_.run_count * static_cast<int>(days.size()), threads);
+    bool parallel = mode == data::ParallelMode::Runs;
+
+    // Lockstep lanes are parallelized inside each day, and share the reference population instead of copying it. They
+    // reproduce the per-carrier engine only.
+    if (input_.options.lockstep && input_.options.engine == data::InfectionEngine::PerCarrier) {
+        parallel = false;
+        if (!lockstep_) lockstep_.emplace(plan_, simulator_.Pool());
+    }
 
-    const auto &infected_history = input_.infected_history.at(input_.state);
-    std::vector<int> expected;
-    for (int i = 0; i < kCheckDays; ++i) {
-        int i0 = infected_history.at(sim::data::ToReferenceDate(start_date + date::days{i - 1})).total_infections;
-        int i1 = infected_history.at(sim::data::ToReferenceDate(start_date + date::days{i})).total_infections;
-        expected.push_back(i1 - i0);
+    // Each day in a group holds a copy of the reference population, so the group size is bounded by the same memory
+    // limit as the per-thread working populations
+    size_t group_size = 1;
+    if (parallel) {
+        auto replicas = kMaxReplicatedPeople / std::max<size_t>(1, reference_pop_.people.size());
+        group_size = std::clamp<size_t>(replicas > static_cast<size_t>(threads) ? replicas - threads : 1, 1,
+                                        static_cast<size_t>(threads));
     }
 
-    // Initialize the population from the beginning
-    auto init_start = std::chrono::system_clock::now();
-    auto init_result = simulator.InitializePopulation(ref_pop, infected_history, input_.vax_history.at(input_.state),
-                                                      input_.variant_history.at(input_.state), start_date);
+    size_t worker_count = lockstep_ ? 0 : parallel ? static_cast<size_t>(threads) : 1;
+    while (workers_.size() < worker_count) {
+        workers_.push_back({simulator_, reference_pop_});
+    }
 
-    // Get the upper and lower bounds
-    auto step0 = GetResultFromBounds(ref_pop, work_pop, expected, simulator, start_date, 2.0, 0.5);
+    std::vector<ContactResult> results;
+    for (size_t first = 0; first < days.size(); first += group_size) {
+        std::vector<int> group(days.begin() + static_cast<long>(first),
+                               days.begin() + static_cast<long>(std::min(days.size(), first + group_size)));
 
-    double upper = step0.prob + 3 * step0.stdev;
-    double lower = step0.prob - 3 * step0.stdev;
-    auto result = GetResultFromBounds(ref_pop, work_pop, expected, simulator, start_date, upper, lower);
+        // Bring the reference population up to each day of the group and keep a copy of it there
+        while (day_pops_.size() < group.size()) {
+            day_pops_.push_back(reference_pop_);
+        }
+        for (size_t i = 0; i < group.size(); ++i) {
+            AdvanceReference(group[i]);
+            day_pops_[i].CopyFrom(reference_pop_);
+        }
 
+        // Get the upper and lower bounds, then the result from a narrower range around the first estimate
+        std::vector<Candidates> bounds(group.size(), {0.5, 2.0});
+        auto step0 = EvaluateCandidates(group, bounds, 0, parallel);
+        for (size_t i = 0; i < group.size(); ++i) {
+            bounds[i] = {step0[i].prob - 3 * step0[i].stdev, step0[i].prob + 3 * step0[i].stdev};
+        }
+        auto step1 = EvaluateCandidates(group, bounds, input_.run_count, parallel);
+        results.insert(results.end(), step1.begin(), step1.end());
+    }
 
-    return result;
+    total_timer.Stop();
+    return results;
 }
 
-sim::ContactResult
-sim::ContactProbabilitySearch::GetResultFromBounds(const sim::Population &reference_pop, sim::Population &working_pop,
-                                                   const std::vector<int> &expected, sim::Simulator &simulator,
-                                                   date::sys_days start_date, double upper, double lower) {
-    double step = (upper - lower) / input_.run_count;
-    std::vector<double> xs; // Contact probabilities
-    std::vector<double> ys; // Errors
+void sim::ContactProbabilitySearch::AdvanceReference(int day) {
+    // Only initialize the reference population from the beginning the first time or if the search went backwards
+    auto start_date = data::ToSysDays(day);
+    if (!reference_ready_ || reference_pop_.today > day) {
+        simulator_.InitializePopulation(reference_pop_, start_date);
+        reference_ready_ = true;
+    } else {
+        simulator_.AdvancePopulation(reference_pop_, start_date);
+    }
+}
 
-    total_timer.Start();
+std::vector<sim::ContactResult>
+sim::ContactProbabilitySearch::EvaluateCandidates(const std::vector<int> &days,
+                                                  const std::vector<Candidates> &candidates, int first_run,
+                                                  bool parallel) {
+    // Candidates of every day are laid out day-major, and each one's random streams are selected by its run number
+    // alone, so the results don't depend on which thread evaluates which candidate
+    int run_count = input_.run_count;
+    int task_count = static_cast<int>(days.size()) * run_count;
+    std::vector<double> xs(task_count);
+    std::vector<double> ys(task_count);
+
+    auto evaluate = [&](size_t first, size_t last) {
+        auto &worker = workers_[parallel ? simulator_.Pool().WorkerIndex() : 0];
+        for (auto task = static_cast<int>(first); task < static_cast<int>(last); ++task) {
+            int d = task / run_count;
+            int run = task % run_count;
+            double step = (candidates[d].upper - candidates[d].lower) / run_count;
+
+            xs[task] = candidates[d].lower + (step * run);
+            ys[task] = CandidateError(worker, day_pops_[d], days[d], xs[task], first_run + run);
+        }
+    };
+
+    // When not parallel the candidates are evaluated one after the other, which leaves the simulation of each day free
+    // to use the threads. The same goes for lockstep batches.
+    if (lockstep_) {
+        const auto lanes = static_cast<int>(LockstepSimulator::kLanes);
+        for (size_t d = 0; d < days.size(); ++d) {
+            auto day_begin = static_cast<long>(d) * run_count;
+            double step = (candidates[d].upper - candidates[d].lower) / run_count;
+            for (int run = 0; run < run_count; ++run) {
+                xs[day_begin + run] = candidates[d].lower + (step * run);
+            }
 
-    for (int run = 0; run < input_.run_count; ++run) {
-        std::vector<int> results;
-
-        copy_timer.Start();
-        working_pop.CopyFrom(reference_pop);
-        copy_timer.Stop();
-
-        // Setting the contact probability
-        double contact_prob = lower + (step * run);
-        simulator.SetProbabilities(contact_prob);
-        int last_infections = working_pop.TotalInfections();
-
-        auto today = start_date;
-        while (today < start_date + date::days{kCheckDays}) {
-            // Add the newly vaccinated
-            if (!input_.vax_history.empty()) {
-                vax_timer.Start();
-                simulator.ApplyVaccines(working_pop, input_.vax_history.at(input_.state));
-                vax_timer.Stop();
+            for (int batch = 0; batch * lanes < run_count; ++batch) {
+                auto begin = day_begin + batch * lanes;
+                auto count = static_cast<size_t>(std::min(lanes, run_count - batch * lanes));
+                LockstepErrors(day_pops_[d], days[d], {xs.data() + begin, count}, {ys.data() + begin, count},
+                               first_run + batch * lanes);
             }
+        }
+    } else if (parallel) {
+        simulator_.Pool().ParallelFor(0, static_cast<size_t>(task_count), 1, evaluate);
+    } else {
+        evaluate(0, static_cast<size_t>(task_count));
+    }
 
-            // Simulate the day's new infections and record them
-            sim_timer.Start();
-            simulator.SimulateDay(working_pop);
-            sim_timer.Stop();
-            auto new_infections = working_pop.TotalInfections() - last_infections;
-            results.push_back(new_infections);
-            last_infections = working_pop.TotalInfections();
+    std::vector<ContactResult> results;
+    for (size_t d = 0; d < days.size(); ++d) {
+        auto begin = static_cast<long>(d) * run_count;
+        results.push_back(FitCandidates({xs.begin() + begin, xs.begin() + begin + run_count},
+                                        {ys.begin() + begin, ys.begin() + begin + run_count}));
+    }
+    return results;
+}
 
-            // Increment the clock
-            today += date::days{1};
-        }
+double sim::ContactProbabilitySearch::CandidateError(Worker &worker, const Population &reference_pop, int day,
+                                                     double contact_prob, int run) const {
+    auto &simulator = worker.simulator;
+    auto &working_pop = worker.population;
+    working_pop.CopyFrom(reference_pop);
+
+    // Setting the contact probability
+    simulator.SetProbabilities(contact_prob);
+    simulator.SetRun(run);
+    int last_infections = working_pop.TotalInfections();
+
+    double error{};
+    for (int i = 0; i < kCheckDays; ++i) {
+        // Add the newly vaccinated
+        simulator.ApplyVaccines(working_pop);
+
+        // Simulate the day's new infections and compare them to the history
+        simulator.SimulateDay(working_pop);
+        auto new_infections = working_pop.TotalInfections() - last_infections;
+        last_infections = working_pop.TotalInfections();
+
+        auto expected = plan_->TotalInfections(day + i) - plan_->TotalInfections(day + i - 1);
+        error += (new_infections - expected);
+    }
+
+    return error / (kCheckDays);
+}
 
-        double error{};
-        for (int i = 0; i < results.size(); ++i) {
-            error += (results[i] - expected[i]);
+void sim::ContactProbabilitySearch::LockstepErrors(const Population &reference_pop, int day,
+                                                   std::span<const double> contact_probs, std::span<double> errors,
+                                                   int first_run) {
+    auto &lockstep = *lockstep_;
+    lockstep.Start(reference_pop, contact_probs, static_cast<uint32_t>(first_run));
+
+    std::array<int, LockstepSimulator::kLanes> last_infections{};
+    std::array<double, LockstepSimulator::kLanes> error{};
+    for (size_t l = 0; l < lockstep.LaneCount(); ++l) {
+        last_infections[l] = lockstep.TotalInfections(l);
+    }
+
+    for (int i = 0; i < kCheckDays; ++i) {
+        lockstep.ApplyVaccines();
+        lockstep.SimulateDay();
+
+        auto expected = plan_->TotalInfections(day + i) - plan_->TotalInfections(day + i - 1);
+        for (size_t l = 0; l < lockstep.LaneCount(); ++l) {
+            auto total = lockstep.TotalInfections(l);
+            error[l] += (total - last_infections[l] - expected);
+            last_infections[l] = total;
         }
-        error = error / (kCheckDays);
-        xs.push_back(contact_prob);
-        ys.push_back(error);
     }
 
+    for (size_t l = 0; l < lockstep.LaneCount(); ++l) {
+        errors[l] = error[l] / kCheckDays;
+    }
+}
+
+sim::ContactResult sim::ContactProbabilitySearch::FitCandidates(const std::vector<double> &xs,
+                                                                const std::vector<double> &ys) {
     // Compute the line of best fit
     double n = static_cast<double>(xs.size());
     double sum_x = 0;
@@ -123,12 +224,6 @@ sim::ContactProbabilitySearch::GetResultFromBounds(const sim::Population &refere
     variance = variance / n;
     auto stdev = std::sqrt(variance);
 
-    total_timer.Stop();
-//    printf("[time] total = %li\n", total_timer.Elapsed());
-//    printf("[time] copy = %li\n", copy_timer.Elapsed());
-//    printf("[time] vax = %li\n", vax_timer.Elapsed());
-//    printf("[time] sim = %li\n", sim_timer.Elapsed());
-
     return {x0, stdev / slope};
 }
 
@@ -2,6 +2,8 @@
 
 #include "covid.hpp"
 #include "data.hpp"
+#include "lockstep.hpp"
+#include "plan.hpp"
 #include "simulators.hpp"
 #include "variant_probabilities.hpp"
 #include "timer.hpp"
@@ -22,25 +24,71 @@ struct ContactSearchResultSet {
 
 void to_json(nlohmann::json &j, const ContactSearchResultSet &o);
 
+/** @class ContactProbabilitySearch
+ *
+ * @brief Estimates the contact probability on each of a series of days by fitting a line through the errors of short
+ * simulations run at a spread of candidate probabilities
+ *
+ * @summary Every candidate is an independent kCheckDays simulation branched off a reference population initialized
+ * up to its day. The reference is advanced through the history from one search day to the next, and the days are
+ * processed in groups: the reference is copied at each day of a group, then the candidates of all days in the group
+ * are spread over the threads, each of which owns a simulator and a working population. When the populations are too
+ * large to replicate per thread the days are processed one at a time and the parallelism is left to the simulation
+ * of each day instead.
+ *
+ * With the experimental lockstep option the days are processed one at a time, and the candidates of a day are
+ * simulated kLanes at a time by a LockstepSimulator. Each candidate keeps the run it has when evaluated on its own,
+ * so the results are the same with the option on or off.
+ */
 class ContactProbabilitySearch {
   public:
-    ContactProbabilitySearch(const data::ProgramInput &input, std::shared_ptr<const sim::VariantDictionary> variants);
+    ContactProbabilitySearch(const data::ProgramInput &input, std::shared_ptr<const SimulationPlan> plan);
 
-    ContactResult FindContactProbability(int day);
+    /** @brief Finds the contact probability on each of the given days, which must be in ascending order
+     */
+    std::vector<ContactResult> FindContactProbabilities(const std::vector<int> &days);
 
-    PerfTimer copy_timer;
-    PerfTimer sim_timer;
     PerfTimer total_timer;
-    PerfTimer vax_timer;
 
   private:
+    struct Worker {
+        Simulator simulator;
+        Population population;
+    };
+
+    struct Candidates {
+        double lower;
+        double upper;
+    };
+
     const data::ProgramInput &input_;
-    std::shared_ptr<const VariantDictionary> variants_;
+    std::shared_ptr<const SimulationPlan> plan_;
+
+    // Search days come in ascending order, so the reference population is advanced through the history from one
+    // search day to the next instead of being initialized from the beginning for each of them
+    Simulator simulator_;
+    Population reference_pop_;
+    bool reference_ready_{};
+
+    std::vector<Population> day_pops_;
+    std::vector<Worker> workers_;
+    std::optional<LockstepSimulator> lockstep_;
+
+    void AdvanceReference(int day);
+
+    std::vector<ContactResult> EvaluateCandidates(const std::vector<int> &days,
+                                                  const std::vector<Candidates> &candidates, int first_run,
+                                                  bool parallel);
+
+    double CandidateError(Worker &worker, const Population &reference_pop, int day, double contact_prob, int run) const;
 
-    ContactResult GetResultFromBounds(const Population &reference_pop, Population &working_pop,
-                                      const std::vector<int> &expected, sim::Simulator &simulator,
-                                      date::sys_days start_date, double upper, double lower);
+    /** @brief Computes the errors of up to LockstepSimulator::kLanes candidates of a day at once, candidate l using
+     * run `first_run + l`
+     */
+    void LockstepErrors(const Population &reference_pop, int day, std::span<const double> contact_probs,
+                        std::span<double> errors, int first_run);
 
+    static ContactResult FitCandidates(const std::vector<double> &xs, const std::vector<double> &ys);
 };
 
-} // namespace sim
\ No newline at end of file
+} // namespace sim
@@ -1,6 +1,10 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <nlohmann/json.hpp>
 #include "../date.h"
+#include "storage.hpp"
 
 namespace sim {
     /** @brief Reference date for standard integer date representations
@@ -12,12 +16,48 @@ namespace sim {
     /** @enum Enumeration for the different covid variants, or None for someone who is not infected
      *
      */
-    enum class Variant {
+    enum class Variant : uint8_t {
         None,
         Alpha,
         Delta
     };
 
+    /** @brief Number of entries in a table indexed by Variant, including Variant::None
+     */
+    constexpr size_t kVariantCount = 3;
+
+    /** @brief Index of the first actual variant (after Variant::None) in a table indexed by Variant
+     */
+    constexpr size_t kFirstVariant = 1;
+
+    inline constexpr size_t VariantIndex(Variant v) { return static_cast<size_t>(v); }
+
+    /** @struct ImmunityWindow
+     *
+     * @brief The contiguous, inclusive range of days on which an individual is protected against a variant
+     *
+     * @summary Stored as a start day and an unsigned span so that the containment test is a single unsigned compare.
+     * Unbounded ends are represented by the smallest / largest StoredDay, and an empty window can only contain the
+     * largest StoredDay.
+     */
+    struct ImmunityWindow {
+        StoredDay from{std::numeric_limits<StoredDay>::max()};
+        StoredDaySpan span{};
+
+        [[nodiscard]] inline bool Contains(int day) const {
+            auto elapsed = static_cast<StoredDaySpan>(day) - static_cast<StoredDaySpan>(from);
+            return static_cast<StoredDaySpan>(elapsed) <= span;
+        }
+
+        static inline ImmunityWindow Between(int first, int last) {
+            if (last < first) return {};
+            auto from = ClampToStoredDay(first);
+            auto to = ClampToStoredDay(last);
+            auto span = static_cast<StoredDaySpan>(to) - static_cast<StoredDaySpan>(from);
+            return {from, static_cast<StoredDaySpan>(span)};
+        }
+    };
+
     struct DailySummary {
     public:
         int day;
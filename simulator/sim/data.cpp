@@ -1,3 +1,4 @@
+#include <random>
 #include <sstream>
 #include "data.hpp"
 
@@ -63,6 +64,13 @@ void sim::data::from_json(const nlohmann::json &j, sim::data::ProgramInput &i) {
     j.at("world_properties").get_to(i.world_properties);
     j.at("options").get_to(i.options);
 
+    if (j.contains("seed")) {
+        j.at("seed").get_to(i.seed);
+    } else {
+        std::random_device rd;
+        i.seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+
     auto infected_history = j.at("infected_history").get<unordered_map<string, unordered_map<string, InfectedHistory>>>();
     auto test_data = j.at("test_history").get<unordered_map<string, unordered_map<string, KnownCaseHistory>>>();
     auto vax_data = j.at("vax_history").get<unordered_map<string, unordered_map<string, VaccineHistory>>>();
@@ -107,7 +115,8 @@ std::unordered_map<sim::Variant, double> sim::data::GetVariantFractions(int date
             for (const auto &[name, fraction] : row.variants) {
                 Variant variant;
                 if (name == "alpha") variant = Variant::Alpha;
-                if (name == "delta") variant = Variant::Delta;
+                else if (name == "delta") variant = Variant::Delta;
+                else continue;
                 results[variant] = fraction;
             }
             return results;
@@ -142,12 +151,13 @@ void sim::data::from_json(const nlohmann::json &j, sim::data::ProgramOptions &o)
     j.at("full_history").get_to(o.full_history);
     j.at("expensive_stats").get_to(o.expensive_stats);
     j.at("mode").get_to(o.mode);
-}
-
-
-double sim::data::DiscreteFunction::operator()(int day) const {
-    auto shifted = day + offset;
-    shifted = std::min((int)values.size()-1, shifted);
-    shifted = std::max(0, shifted);
-    return values[shifted];
+    o.immunity_bitsets = j.value("immunity_bitsets", false);
+    o.parallelism = j.value("parallelism", ParallelMode::Auto);
+    o.engine = j.value("engine", InfectionEngine::PerCarrier);
+    o.cache_dir = j.value("cache_dir", std::string{});
+    o.prefetch_batch = j.value("prefetch_batch", 16);
+    o.threads = j.value("threads", 0);
+    o.serial_threshold = j.value("serial_threshold", -1);
+    o.lockstep = j.value("lockstep", false);
+    o.sparse_population = j.value("sparse_population", false);
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -14,7 +16,25 @@ namespace sim::data {
 
     enum class ProgramMode {
         Simulate = 1,
-        FindContactProb = 2
+        FindContactProb = 2,
+        Benchmark = 3
+    };
+
+    /** @brief How independent replicas are spread over threads: within each simulated day across carriers, or
+     * across whole runs with each thread owning its own population
+     */
+    enum class ParallelMode {
+        Auto = 0,
+        Carriers = 1,
+        Runs = 2
+    };
+
+    /** @brief How the simulation finds each day's transmissions: by following every contact of every carrier, or by
+     * sampling them from the carriers' total force of infection
+     */
+    enum class InfectionEngine {
+        PerCarrier = 0,
+        Aggregate = 1
     };
 
     struct StateInfo {
@@ -62,7 +82,18 @@ namespace sim::data {
         std::vector<double> values;
         int offset;
 
-        double operator()(int day) const;
+        inline double operator()(int day) const {
+            return values[Index(day)];
+        }
+
+        /** @brief The position in `values` which holds the function's value on a day
+         */
+        [[nodiscard]] inline int Index(int day) const {
+            auto shifted = day + offset;
+            shifted = std::min((int)values.size()-1, shifted);
+            shifted = std::max(0, shifted);
+            return shifted;
+        }
     };
 
     void from_json(const nlohmann::json &j, DiscreteFunction &f);
@@ -87,6 +118,37 @@ namespace sim::data {
         bool full_history = false;
         bool expensive_stats = false;
         ProgramMode mode = ProgramMode::Simulate;
+
+        // Screen contacts against per-day immunity bitsets instead of the person records
+        bool immunity_bitsets = false;
+
+        ParallelMode parallelism = ParallelMode::Auto;
+
+        InfectionEngine engine = InfectionEngine::PerCarrier;
+
+        // Directory for snapshots of initialized populations, caching is off when empty
+        std::string cache_dir;
+
+        // Number of contacts drawn ahead of being screened, so that their records can be prefetched together. 1
+        // screens every contact as soon as it's drawn. The benchmark mode measures which size suits a machine best.
+        int prefetch_batch = 16;
+
+        // Number of threads the simulation runs on, including the main one. 0 uses one per hardware thread.
+        int threads = 0;
+
+        // Days with fewer carriers than this run on a single thread, since splitting them costs more than it saves. -1
+        // calibrates it when the simulator starts and keeps it up to date from the measured cost of a carrier.
+        int serial_threshold = -1;
+
+        // Experimental: simulation ensembles and the contact probability search's candidates of a day run in lockstep
+        // batches which share one pass over the population, see LockstepSimulator. Gives the same results, and only
+        // applies to the per-carrier engine.
+        bool lockstep = false;
+
+        // Only store the records of members who have been infected or vaccinated, so that memory and population
+        // copies scale with the epidemic instead of the census, at the price of a table lookup per access. Pays off
+        // at fine scales where most members are never touched, see People.
+        bool sparse_population = false;
     };
 
     void from_json(const nlohmann::json &j, ProgramOptions &o);
@@ -100,6 +162,7 @@ namespace sim::data {
         int contact_day_interval;   // When running a contact prob search, go from start_day to end_day every n days
         int population_scale;
         int run_count;
+        uint64_t seed;              // Seeds every random stream, taken from the input or generated if not supplied
         ProgramOptions options;
         WorldProperties world_properties;
         std::unordered_map<std::string, std::unordered_map<int, InfectedHistory>> infected_history;
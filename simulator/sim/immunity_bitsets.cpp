@@ -0,0 +1,253 @@
+#include "immunity_bitsets.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+    // Packs the low bits of eight consecutive bytes into one byte, with the first byte in the least significant bit
+    inline uint64_t PackBytes(const uint8_t *bytes) {
+        uint64_t chunk;
+        std::memcpy(&chunk, bytes, sizeof(chunk));
+        return ((chunk & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56;
+    }
+
+    // Packs one bit per member from a predicate, 64 members at a time, with the first member of each word in its
+    // least significant bit. Evaluate(base, mask) must fill 64 bytes of mask with 0 or 1 for members base...base+63.
+    template <typename Evaluate, typename Predicate>
+    void PackBits(std::vector<uint64_t> &bits, size_t size, Evaluate evaluate, Predicate predicate) {
+        bits.resize((size + 63) / 64);
+        size_t full_words = size / 64;
+        alignas(64) uint8_t mask[64];
+
+        for (size_t word = 0; word < full_words; ++word) {
+            evaluate(word * 64, mask);
+
+            uint64_t packed = 0;
+            for (size_t k = 0; k < 8; ++k) {
+                packed |= PackBytes(mask + 8 * k) << (8 * k);
+            }
+            bits[word] = packed;
+        }
+
+        if (full_words < bits.size()) {
+            uint64_t packed = 0;
+            for (size_t i = full_words * 64; i < size; ++i) {
+                packed |= static_cast<uint64_t>(predicate(i)) << (i & 63);
+            }
+            bits[full_words] = packed;
+        }
+    }
+
+    // Fills the bits of members whose immunity window contains today. Each window is read as a single integer (start
+    // day in the low half, span in the high half) so the loop works on whole lanes without any branches or strided
+    // loads, which lets the compiler vectorize it when wide enough integer compares are available.
+    void PackWindows(std::vector<uint64_t> &bits, const std::vector<sim::ImmunityWindow> &windows, int today) {
+        using Word = std::conditional_t<sizeof(sim::ImmunityWindow) == sizeof(uint64_t), uint64_t, uint32_t>;
+        static_assert(sizeof(sim::ImmunityWindow) == sizeof(Word));
+        constexpr int kHalf = 4 * sizeof(Word);
+        constexpr int64_t kLow = (int64_t{1} << kHalf) - 1;
+
+        const auto *raw = windows.data();
+        const int64_t t = static_cast<int64_t>(today) & kLow;
+
+        auto evaluate = [raw, t](size_t base, uint8_t *mask) {
+            for (size_t b = 0; b < 64; ++b) {
+                Word w;
+                std::memcpy(&w, raw + base + b, sizeof(w));
+                int64_t elapsed = (t - static_cast<int64_t>(w & kLow)) & kLow;
+                mask[b] = elapsed <= static_cast<int64_t>(w >> kHalf);
+            }
+        };
+        PackBits(bits, windows.size(), evaluate, [raw, today](size_t i) { return raw[i].Contains(today); });
+    }
+
+    template <typename Predicate>
+    void PackPredicate(std::vector<uint64_t> &bits, size_t size, Predicate predicate) {
+        auto evaluate = [&predicate](size_t base, uint8_t *mask) {
+            for (size_t b = 0; b < 64; ++b) mask[b] = predicate(base + b);
+        };
+        PackBits(bits, size, evaluate, predicate);
+    }
+}
+
+bool sim::ImmunityBitsets::CanUpdateIncrementally(const sim::SimulationPlan &plan) {
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        if (!plan.variants[v]->HasNaturalWindows() || !plan.variants[v]->HasVaxWindows())
+            return false;
+    }
+    return true;
+}
+
+void sim::ImmunityBitsets::Update(const sim::Population &population, const sim::SimulationPlan &plan) {
+    bool same_state = &population == population_ && population.BulkRevision() == revision_;
+    if (!same_state || !CanUpdateIncrementally(plan) || population.today < day_ || population.today > day_ + 1) {
+        Rebuild(population, plan);
+        return;
+    }
+
+    // Pick up the touched members first, then anyone whose windows open or close today
+    Drain(population, plan, dirty_);
+    if (population.today == day_ + 1) {
+        day_ = population.today;
+        Drain(population, plan, calendar_[static_cast<size_t>(day_) % calendar_.size()]);
+    }
+}
+
+void sim::ImmunityBitsets::Drain(const sim::Population &population, const sim::SimulationPlan &plan,
+                                 std::vector<uint64_t> &flags) {
+    for (size_t i = 0; i < flags.size(); ++i) {
+        // Flags may be set for later days while draining (a recomputed word schedules its next change), but never for
+        // the day being drained, so it's safe to clear each flag word as it's consumed
+        uint64_t pending = flags[i];
+        flags[i] = 0;
+        while (pending) {
+            auto bit = static_cast<size_t>(__builtin_ctzll(pending));
+            pending &= pending - 1;
+            RecomputeWord(population, plan, i * 64 + bit);
+        }
+    }
+}
+
+void sim::ImmunityBitsets::Schedule(int day, size_t word) {
+    // Changes beyond the calendar's reach are scheduled at its edge, where recomputing the word schedules them again
+    int ahead = std::min(day - day_, static_cast<int>(calendar_.size()) - 1);
+    auto &slot = calendar_[static_cast<size_t>(day_ + ahead) % calendar_.size()];
+    slot[word >> 6] |= uint64_t{1} << (word & 63);
+}
+
+void sim::ImmunityBitsets::RecomputeWord(const sim::Population &population, const sim::SimulationPlan &plan,
+                                         size_t word) {
+    const auto &people = population.people;
+    size_t begin = word * 64;
+    size_t end = std::min(begin + 64, people.size());
+
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        const auto &info = *plan.variants[v];
+        uint64_t natural = 0;
+        uint64_t vaccine = 0;
+        for (size_t i = begin; i < end; ++i) {
+            natural |= static_cast<uint64_t>(info.IsPersonNatImmune(people, i, population.today)) << (i - begin);
+            vaccine |= static_cast<uint64_t>(info.IsPersonVaxImmune(people, i, population.today)) << (i - begin);
+        }
+        natural_[v][word] = natural;
+        vaccine_[v][word] = vaccine;
+    }
+
+    ScheduleNextChange(population, word);
+}
+
+void sim::ImmunityBitsets::ScheduleNextChange(const sim::Population &population, size_t word) {
+    const auto &people = population.people;
+    const int today = population.today;
+    size_t begin = word * 64;
+    size_t end = std::min(begin + 64, people.size());
+
+    // The next day on which any window of this word's members opens or closes
+    int next_change = std::numeric_limits<int>::max();
+    auto consider = [today, &next_change](const ImmunityWindow &w) {
+        if (w.from == kMaxStoredDay) return;
+        if (w.from > today) {
+            next_change = std::min<int>(next_change, w.from);
+        } else {
+            // Windows which run to the largest stored day never close
+            long after_last = static_cast<long>(w.from) + static_cast<long>(w.span) + 1;
+            if (after_last > today && after_last <= kMaxStoredDay) next_change = std::min<int>(next_change, after_last);
+        }
+    };
+
+    for (size_t i = begin; i < end; ++i) {
+        auto slot = people.Slot(i);
+        for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+            consider(people.hot.natural_window[v][slot]);
+            consider(people.hot.vaccine_window[v][slot]);
+        }
+    }
+
+    if (next_change != std::numeric_limits<int>::max())
+        Schedule(next_change, word);
+}
+
+void sim::ImmunityBitsets::Rebuild(const sim::Population &population, const sim::SimulationPlan &plan) {
+    const auto &people = population.people;
+    const int today = population.today;
+    population_ = &population;
+    revision_ = population.BulkRevision();
+    day_ = today;
+
+    if (people.IsSparse()) {
+        RebuildSparse(population, plan);
+    } else {
+        for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+            const auto &info = *plan.variants[v];
+
+            if (info.HasNaturalWindows()) {
+                PackWindows(natural_[v], people.hot.natural_window[v], today);
+            } else {
+                PackPredicate(natural_[v], people.size(),
+                         [&info, &people, today](size_t i) { return info.IsPersonNatImmune(people, i, today); });
+            }
+
+            if (info.HasVaxWindows()) {
+                PackWindows(vaccine_[v], people.hot.vaccine_window[v], today);
+            } else {
+                PackPredicate(vaccine_[v], people.size(),
+                         [&info, &people, today](size_t i) { return info.IsPersonVaxImmune(people, i, today); });
+            }
+        }
+    }
+
+    // Set up the incremental bookkeeping, scheduling every word at its next change
+    size_t words = (people.size() + 63) / 64;
+    size_t flag_words = (words + 63) / 64;
+    dirty_.assign(flag_words, 0);
+    if (!CanUpdateIncrementally(plan)) return;
+
+    int horizon = 2;
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        horizon = std::max(horizon, plan.variants[v]->WindowHorizon() + 1);
+    }
+    calendar_.resize(static_cast<size_t>(horizon));
+    for (auto &slot : calendar_) {
+        slot.assign(flag_words, 0);
+    }
+
+    if (people.IsSparse()) {
+        // Members without a record of their own have no windows, so only the words of those who do are scheduled
+        std::vector<uint64_t> seen(flag_words, 0);
+        for (size_t slot = people.FirstMemberSlot(); slot < people.SlotCount(); ++slot) {
+            auto word = people.Member(slot) >> 6;
+            auto bit = uint64_t{1} << (word & 63);
+            if (seen[word >> 6] & bit) continue;
+            seen[word >> 6] |= bit;
+            ScheduleNextChange(population, word);
+        }
+        return;
+    }
+
+    for (size_t word = 0; word < words; ++word) {
+        ScheduleNextChange(population, word);
+    }
+}
+
+void sim::ImmunityBitsets::RebuildSparse(const sim::Population &population, const sim::SimulationPlan &plan) {
+    // Only members with a record of their own can be immune, so the bits start out clear and each record sets its
+    // member's bits
+    const auto &people = population.people;
+    const int today = population.today;
+    const size_t words = (people.size() + 63) / 64;
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        natural_[v].assign(words, 0);
+        vaccine_[v].assign(words, 0);
+    }
+
+    for (size_t slot = people.FirstMemberSlot(); slot < people.SlotCount(); ++slot) {
+        const auto member = people.Member(slot);
+        const auto bit = uint64_t{1} << (member & 63);
+        for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+            const auto &info = *plan.variants[v];
+            if (info.IsRecordNatImmune(people, slot, today)) natural_[v][member >> 6] |= bit;
+            if (info.IsRecordVaxImmune(people, slot, today)) vaccine_[v][member >> 6] |= bit;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "covid.hpp"
+#include "plan.hpp"
+#include "population/population.hpp"
+
+namespace sim {
+
+    /** @class ImmunityBitsets
+     *
+     * @brief A per-variant record of who in a population is immune on the current day, one bit per person
+     *
+     * @summary Contacts in the simulation are drawn uniformly from the whole population, so checking immunity on the
+     * person records is almost always a cache miss. With these bitsets a contact is screened by reading a single bit,
+     * and at coarse scales the bitsets fit in cache when the person records do not.
+     *
+     * The bits are kept current incrementally. A full rebuild happens the first time a population is seen, or after
+     * it has been reset, copied over, or skipped a day. After that, a word of 64 people is only recomputed when one of
+     * its members was touched (infected or vaccinated) or when one of its members' immunity windows opens or
+     * closes, which is found through a calendar of per-day word flags. Incremental updates need every variant to use
+     * immunity windows; otherwise the bits are rebuilt every day.
+     *
+     * The bitsets assume that every change to the population between updates is reported through Touch, which holds
+     * as long as the population is only advanced by the simulator that owns them.
+     */
+    class ImmunityBitsets {
+    public:
+        /** @brief Brings the bits up to date for `population.today`
+         */
+        void Update(const Population &population, const SimulationPlan &plan);
+
+        /** @brief Reports that the member at `index` had their immunity changed. Ignored if the bits are currently
+         * tracking a different population.
+         */
+        inline void Touch(const Population &population, size_t index) {
+            if (&population == population_ && population.BulkRevision() == revision_)
+                dirty_[index >> 12] |= uint64_t{1} << ((index >> 6) & 63);
+        }
+
+        [[nodiscard]] inline bool IsNatImmune(size_t variant_index, size_t person_index) const {
+            return (natural_[variant_index][person_index >> 6] >> (person_index & 63)) & 1;
+        }
+
+        [[nodiscard]] inline bool IsVaxImmune(size_t variant_index, size_t person_index) const {
+            return (vaccine_[variant_index][person_index >> 6] >> (person_index & 63)) & 1;
+        }
+
+        /** @brief Starts loading the words which IsNatImmune and IsVaxImmune will read for a member
+         */
+        inline void Prefetch(size_t variant_index, size_t person_index) const {
+            __builtin_prefetch(&natural_[variant_index][person_index >> 6]);
+            __builtin_prefetch(&vaccine_[variant_index][person_index >> 6]);
+        }
+
+    private:
+        std::array<std::vector<uint64_t>, kVariantCount> natural_;
+        std::array<std::vector<uint64_t>, kVariantCount> vaccine_;
+
+        // Bitsets over words (one bit per 64 people): words touched since the last update, and a ring of words which
+        // need to be recomputed on each upcoming day
+        std::vector<uint64_t> dirty_;
+        std::vector<std::vector<uint64_t>> calendar_;
+
+        const Population *population_{};
+        uint64_t revision_{};
+        int day_{};
+
+        void Rebuild(const Population &population, const SimulationPlan &plan);
+        void RebuildSparse(const Population &population, const SimulationPlan &plan);
+        void RecomputeWord(const Population &population, const SimulationPlan &plan, size_t word);
+        void ScheduleNextChange(const Population &population, size_t word);
+        void Schedule(int day, size_t word);
+        void Drain(const Population &population, const SimulationPlan &plan, std::vector<uint64_t> &flags);
+        [[nodiscard]] static bool CanUpdateIncrementally(const SimulationPlan &plan);
+    };
+
+}
@@ -0,0 +1,11 @@
+#include "infection_claims.hpp"
+
+void sim::InfectionClaims::Resize(size_t population_size) {
+    auto words = (population_size + 63) / 64;
+    if (words == words_) return;
+
+    words_ = words;
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        claims_[v].assign(words_, 0);
+    }
+}
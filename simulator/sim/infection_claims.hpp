@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "covid.hpp"
+
+namespace sim {
+
+    /** @class InfectionClaims
+     *
+     * @brief A per-variant bitmap of the members of a population who were successfully infected during a day
+     *
+     * @summary Threads finding transmissions claim the contact's bit for the carrier's variant with an atomic OR, so
+     * no thread-local lists have to be merged and repeated transmissions to the same member cost nothing extra. The
+     * claims are then collected word by word: each member is infected once, with the lowest variant that claimed
+     * them, and the words are cleared as they're read. Since the bits don't depend on the order in which they were
+     * set, neither does the outcome.
+     */
+    class InfectionClaims {
+    public:
+        /** @brief Sizes the bitmaps for a population, clearing them if the size changed
+         */
+        void Resize(size_t population_size);
+
+        [[nodiscard]] inline size_t WordCount() const { return words_; }
+
+        /** @brief Records a transmission of a variant to a member. Safe to call from several threads at once.
+         */
+        inline void Claim(size_t variant_index, size_t person_index) {
+            std::atomic_ref<uint64_t> word(claims_[variant_index][person_index >> 6]);
+            word.fetch_or(uint64_t{1} << (person_index & 63), std::memory_order_relaxed);
+        }
+
+        /** @brief The members claimed by any variant in a word, one bit each, leaving the claims in place
+         */
+        [[nodiscard]] inline uint64_t Claimed(size_t word) const {
+            uint64_t claimed = 0;
+            for (size_t v = kFirstVariant; v < kVariantCount; ++v) claimed |= claims_[v][word];
+            return claimed;
+        }
+
+        /** @brief Calls `f(person_index, variant_index)` for every member claimed in a word, in order of index and
+         * with the lowest variant that claimed them, then clears the word. Different words may be collected from
+         * different threads at once.
+         */
+        template <typename F>
+        inline void Collect(size_t word, F &&f) {
+            std::array<uint64_t, kVariantCount> won{};
+            uint64_t taken = 0;
+            for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+                won[v] = claims_[v][word] & ~taken;
+                claims_[v][word] = 0;
+                taken |= won[v];
+            }
+
+            while (taken) {
+                auto bit = std::countr_zero(taken);
+                size_t v = kFirstVariant;
+                while (!((won[v] >> bit) & 1)) ++v;
+                f(word * 64 + static_cast<size_t>(bit), v);
+                taken &= taken - 1;
+            }
+        }
+
+    private:
+        std::array<std::vector<uint64_t>, kVariantCount> claims_;
+        size_t words_{};
+    };
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace sim {
+
+    /** @brief The number of replicas held side by side in a Lanes vector, which is one AVX2 register of 32 bit values
+     */
+    constexpr size_t kLaneCount = 8;
+
+    /** @brief One value per replica, kept together so that the values of all the replicas can be loaded, compared and
+     * updated as one vector
+     */
+    template <typename T>
+    using Lanes = std::array<T, kLaneCount>;
+
+    /** @brief One bit per lane, lane i in bit i
+     */
+    using LaneMask = uint32_t;
+
+    constexpr LaneMask kAllLanes = (LaneMask{1} << kLaneCount) - 1;
+
+    /* Comparisons and updates of whole Lanes vectors. With AVX2 (see DELTA_SIM_NATIVE) each is a few vector
+     * instructions, otherwise a plain loop over the lanes.
+     */
+
+    /** @brief The lanes holding a non-zero value
+     */
+    inline LaneMask NonZeroLanes(const Lanes<uint8_t> &values) {
+#if defined(__AVX2__)
+        uint64_t bytes;
+        std::memcpy(&bytes, values.data(), sizeof(bytes));
+        __m128i v = _mm_cvtsi64_si128(static_cast<long long>(bytes));
+        auto zero = static_cast<LaneMask>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())));
+        return ~zero & kAllLanes;
+#else
+        LaneMask mask = 0;
+        for (size_t l = 0; l < kLaneCount; ++l) mask |= static_cast<LaneMask>(values[l] != 0) << l;
+        return mask;
+#endif
+    }
+
+    /** @brief The lanes holding a value less than `bound`
+     */
+    inline LaneMask LanesBelow(const Lanes<int32_t> &values, int32_t bound) {
+#if defined(__AVX2__)
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values.data()));
+        __m256i below = _mm256_cmpgt_epi32(_mm256_set1_epi32(bound), v);
+        return static_cast<LaneMask>(_mm256_movemask_ps(_mm256_castsi256_ps(below)));
+#else
+        LaneMask mask = 0;
+        for (size_t l = 0; l < kLaneCount; ++l) mask |= static_cast<LaneMask>(values[l] < bound) << l;
+        return mask;
+#endif
+    }
+
+    /** @brief The lanes whose inclusive range [first, last] holds `value`
+     */
+    inline LaneMask LanesBetween(const Lanes<int32_t> &first, const Lanes<int32_t> &last, int32_t value) {
+#if defined(__AVX2__)
+        __m256i v = _mm256_set1_epi32(value);
+        __m256i before = _mm256_cmpgt_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(first.data())), v);
+        __m256i after = _mm256_cmpgt_epi32(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(last.data())));
+        auto outside = static_cast<LaneMask>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(before, after))));
+        return ~outside & kAllLanes;
+#else
+        LaneMask mask = 0;
+        for (size_t l = 0; l < kLaneCount; ++l) {
+            mask |= static_cast<LaneMask>(first[l] <= value && value <= last[l]) << l;
+        }
+        return mask;
+#endif
+    }
+
+    /** @brief Adds `values` to `to` lane by lane
+     */
+    inline void AddLanes(Lanes<int32_t> &to, const Lanes<int32_t> &values) {
+#if defined(__AVX2__)
+        auto *target = reinterpret_cast<__m256i *>(to.data());
+        __m256i sum = _mm256_add_epi32(_mm256_loadu_si256(target),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values.data())));
+        _mm256_storeu_si256(target, sum);
+#else
+        for (size_t l = 0; l < kLaneCount; ++l) to[l] += values[l];
+#endif
+    }
+
+    /** @brief Adds one to every lane of `to` in `lanes`
+     */
+    inline void CountLanes(Lanes<int32_t> &to, LaneMask lanes) {
+#if defined(__AVX2__)
+        // Each lane's bit is moved to the top of its element, which an arithmetic shift then spreads to -1 or 0
+        const __m256i shifts = _mm256_setr_epi32(31, 30, 29, 28, 27, 26, 25, 24);
+        __m256i bits = _mm256_sllv_epi32(_mm256_set1_epi32(static_cast<int>(lanes)), shifts);
+        auto *target = reinterpret_cast<__m256i *>(to.data());
+        _mm256_storeu_si256(target, _mm256_sub_epi32(_mm256_loadu_si256(target), _mm256_srai_epi32(bits, 31)));
+#else
+        for (size_t l = 0; l < kLaneCount; ++l) to[l] += static_cast<int32_t>((lanes >> l) & 1);
+#endif
+    }
+
+}
@@ -0,0 +1,525 @@
+#include "lockstep.hpp"
+#include <algorithm>
+#include <bit>
+#include <optional>
+#include "population/recovery_wheel.hpp"
+#include "probabilities.hpp"
+
+sim::LockstepSimulator::LaneTally &sim::LockstepSimulator::LaneTally::operator+=(const LaneTally &other) {
+    AddLanes(infections, other.infections);
+    AddLanes(first_infections, other.first_infections);
+    AddLanes(reinfections, other.reinfections);
+    AddLanes(vaccinated_infections, other.vaccinated_infections);
+    AddLanes(alpha_infections, other.alpha_infections);
+    AddLanes(delta_infections, other.delta_infections);
+    AddLanes(natural_saves, other.natural_saves);
+    AddLanes(vaccine_saves, other.vaccine_saves);
+    AddLanes(vaccinations, other.vaccinations);
+    return *this;
+}
+
+void sim::LockstepSimulator::LaneWindows::Set(size_t lane, ImmunityWindow window) {
+    // The last day is at most the largest StoredDay, but adding the span to the first one can overflow a StoredDay
+    first[lane] = window.from;
+    last[lane] = static_cast<int32_t>(static_cast<int64_t>(window.from) + window.span);
+}
+
+sim::LockstepSimulator::LockstepSimulator(std::shared_ptr<const SimulationPlan> plan, ThreadPool &pool)
+    : plan_(std::move(plan)), pool_(&pool), seed_(plan_->seed) {
+    static_assert(kLanes == Philox4x32::kParallelBlocks);
+
+    // The first flag stands for a curve which is never positive, which is where members carrying no variant look
+    infectivity_positive_.push_back(0);
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        const auto &infectivity = plan_->variants[v]->Properties().infectivity;
+        curve_offsets_[v] = infectivity.offset;
+        curve_last_[v] = static_cast<int32_t>(infectivity.values.size()) - 1;
+        curve_starts_[v] = static_cast<int32_t>(infectivity_positive_.size());
+        for (double value : infectivity.values) {
+            infectivity_positive_.push_back(value > 0);
+        }
+    }
+}
+
+void sim::LockstepSimulator::Start(const Population &reference, std::span<const double> contact_probabilities,
+                                   uint32_t first_run) {
+    reference_ = &reference;
+    today_ = reference.today;
+    lane_count_ = std::min(kLanes, contact_probabilities.size());
+    active_ = (LaneMask{1} << lane_count_) - 1;
+
+    const size_t size = reference.people.size();
+    for (size_t l = 0; l < kLanes; ++l) {
+        runs_[l] = first_run + static_cast<uint32_t>(l);
+        infectious_counts_[l] = l < lane_count_ ? reference.InfectiousCount() : 0;
+        if (l < lane_count_) {
+            tables_[l].Prepare(*plan_, contact_probabilities[l], size);
+            claims_[l].Resize(size);
+        }
+    }
+    vaccinated_.fill(reference.total_vaccinated);
+    tally_ = {};
+
+    // Only the members which had a record in the last batch have to be reset, and every member sharing a word of
+    // the bits with one of them had a record as well
+    const size_t words = (size + 63) / 64;
+    if (diverged_.size() != words) {
+        diverged_.assign(words, 0);
+        vaccinated_everywhere_.assign(words, 0);
+    } else {
+        for (size_t slot = 1; slot < owners_.size(); ++slot) {
+            diverged_[owners_[slot] >> 6] = 0;
+            vaccinated_everywhere_[owners_[slot] >> 6] = 0;
+        }
+    }
+    records_.resize(1);
+    owners_.resize(1);
+    record_slots_.Clear();
+
+    carriers_.assign(reference.Infectious().begin(), reference.Infectious().end());
+}
+
+bool sim::LockstepSimulator::IsInfectious(size_t lane, size_t index) const {
+    return Diverged(index) ? Record(index).infectious[lane] != 0 : reference_->IsInfectious(index);
+}
+
+sim::Person sim::LockstepSimulator::Member(size_t lane, size_t index) const {
+    Person person = reference_->people[index];
+    if (!Diverged(index)) return person;
+
+    const auto &record = Record(index);
+    person.variant = static_cast<Variant>(record.variant[lane]);
+    person.infected_day = static_cast<StoredDay>(record.infected_day[lane]);
+    person.symptom_onset = static_cast<StoredDay>(record.symptom_onset[lane]);
+    person.vaccination_day = static_cast<StoredDay>(record.vaccination_day[lane]);
+    person.natural_immunity_scalar = record.natural_immunity_scalar[lane];
+    person.vaccine_immunity_scalar = record.vaccine_immunity_scalar[lane];
+    person.is_vaccinated = record.is_vaccinated[lane] != 0;
+    return person;
+}
+
+size_t sim::LockstepSimulator::Diverge(size_t index) {
+    if (Diverged(index)) return record_slots_.Find(index);
+
+    const auto &people = reference_->people;
+    const auto slot = people.Slot(index);
+    LaneRecord record;
+    record.infected_day.fill(people.hot.infected_day[slot]);
+    record.symptom_onset.fill(people.hot.symptom_onset[slot]);
+    record.vaccination_day.fill(people.hot.vaccination_day[slot]);
+    record.recovery_day.fill(people.cold.recovery_day[slot]);
+    record.natural_immunity_scalar.fill(static_cast<float>(people.hot.natural_immunity_scalar[slot]));
+    record.vaccine_immunity_scalar.fill(static_cast<float>(people.hot.vaccine_immunity_scalar[slot]));
+    record.variant.fill(static_cast<uint8_t>(people.hot.variant[slot]));
+    record.is_vaccinated.fill(people.hot.is_vaccinated[slot]);
+    record.infectious.fill(reference_->IsInfectious(index));
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        for (size_t l = 0; l < kLanes; ++l) {
+            record.natural_windows[v - kFirstVariant].Set(l, people.hot.natural_window[v][slot]);
+            record.vaccine_windows[v - kFirstVariant].Set(l, people.hot.vaccine_window[v][slot]);
+        }
+    }
+
+    const auto record_slot = records_.size();
+    records_.push_back(record);
+    owners_.push_back(static_cast<uint32_t>(index));
+    record_slots_.Insert(index, static_cast<uint32_t>(record_slot));
+    diverged_[index >> 6] |= uint64_t{1} << (index & 63);
+    return record_slot;
+}
+
+sim::LaneMask sim::LockstepSimulator::InfectiousLanes(const LaneRecord &record, Lanes<int32_t> &curve_indices) const {
+#if defined(__AVX2__)
+    // Each lane picks its variant's offset, last index and start among the flags, then gathers its flag
+    auto load = [](const Lanes<int32_t> &x) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x.data())); };
+    __m256i variants = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(record.variant.data())));
+    __m256i offsets = _mm256_permutevar8x32_epi32(load(curve_offsets_), variants);
+    __m256i last = _mm256_permutevar8x32_epi32(load(curve_last_), variants);
+    __m256i starts = _mm256_permutevar8x32_epi32(load(curve_starts_), variants);
+
+    __m256i days = _mm256_sub_epi32(_mm256_set1_epi32(today_), load(record.symptom_onset));
+    __m256i index = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(days, offsets), _mm256_setzero_si256()), last);
+    __m256i positive = _mm256_i32gather_epi32(infectivity_positive_.data(), _mm256_add_epi32(starts, index), 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(curve_indices.data()), index);
+    auto mask = static_cast<LaneMask>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(positive, _mm256_setzero_si256()))));
+#else
+    LaneMask mask = 0;
+    for (size_t l = 0; l < kLanes; ++l) {
+        const auto v = record.variant[l];
+        curve_indices[l] = std::clamp(today_ - record.symptom_onset[l] + curve_offsets_[v], 0, curve_last_[v]);
+        mask |= static_cast<LaneMask>(infectivity_positive_[curve_starts_[v] + curve_indices[l]] != 0) << l;
+    }
+#endif
+    return mask & NonZeroLanes(record.infectious) & active_;
+}
+
+void sim::LockstepSimulator::ApplyVaccines() {
+    // The same scan as Simulator::ApplyVaccines, made once for all the replicas. Each replica draws from its own
+    // vaccination stream and stops once it has vaccinated enough people.
+    auto total_completed_vax = plan_->TotalCompletedVax(today_ + 21);
+    if (total_completed_vax == SimulationPlan::kNoRecord)
+        return;
+
+    const int to_be_vaxxed = total_completed_vax / reference_->Scale();
+    LaneMask scanning = LanesBelow(vaccinated_, to_be_vaxxed) & active_;
+    if (!scanning)
+        return;
+
+    std::array<std::optional<Probabilities>, kLanes> probs;
+    for (LaneMask lanes = scanning; lanes; lanes &= lanes - 1) {
+        const auto l = static_cast<size_t>(std::countr_zero(lanes));
+        probs[l].emplace(seed_, runs_[l], today_, RandomStream::Vaccination);
+    }
+
+    const auto &people = reference_->people;
+    const int last_infection = today_ - 30;
+    for (size_t index = 0; scanning && index < people.size(); ++index) {
+        // Nobody is ever unvaccinated, so whoever the reference has vaccinated is vaccinated in every replica, and so
+        // is a record once every replica has vaccinated them. Neither needs a look at their record.
+        const auto slot = people.Slot(index);
+        if (people.hot.is_vaccinated[slot] || VaccinatedEverywhere(index)) continue;
+
+        LaneMask eligible;
+        if (Diverged(index)) {
+            const auto &record = Record(index);
+            eligible = ~NonZeroLanes(record.is_vaccinated) & ~NonZeroLanes(record.infectious) &
+                       (~NonZeroLanes(record.variant) | LanesBelow(record.infected_day, last_infection)) & scanning;
+        } else {
+            // Someone without a record is the same in every replica
+            const bool can_vaccinate =
+                !reference_->IsInfectious(index) &&
+                (people.hot.variant[slot] == Variant::None || people.hot.infected_day[slot] < last_infection);
+            eligible = can_vaccinate ? scanning : 0;
+        }
+        if (!eligible) continue;
+
+        auto &record = records_[Diverge(index)];
+        for (; eligible; eligible &= eligible - 1) {
+            const auto l = static_cast<size_t>(std::countr_zero(eligible));
+            record.is_vaccinated[l] = 1;
+            record.vaccination_day[l] = today_;
+            record.vaccine_immunity_scalar[l] =
+                static_cast<float>(StoredScalar(static_cast<float>(probs[l]->UniformScalar())));
+            for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+                const auto &info = *plan_->variants[v];
+                if (info.HasVaxWindows()) {
+                    record.vaccine_windows[v - kFirstVariant].Set(
+                        l, info.VaxImmunityWindow(record.vaccine_immunity_scalar[l], today_));
+                }
+            }
+            tally_.vaccinations[l]++;
+            if (++vaccinated_[l] >= to_be_vaxxed) {
+                scanning &= ~(LaneMask{1} << l);
+            }
+        }
+        if ((NonZeroLanes(record.is_vaccinated) & active_) == active_) {
+            vaccinated_everywhere_[index >> 6] |= uint64_t{1} << (index & 63);
+        }
+    }
+}
+
+void sim::LockstepSimulator::SimulateDay(std::span<DailySummary> summaries, bool expensive_stats) {
+    if (lane_count_ == 0) return;
+
+    // The same steps as Simulator::SimulateDay
+    TraceCarrierContacts();
+    RemoveRecovered();
+    ApplyClaims();
+    for (size_t l = 0; l < std::min(lane_count_, summaries.size()); ++l) {
+        summaries[l] = GetDailySummary(l, expensive_stats);
+    }
+    today_++;
+}
+
+sim::DailySummary sim::LockstepSimulator::GetDailySummary(size_t lane, bool expensive) const {
+    const auto &reference = *reference_;
+    const int scale = reference.Scale();
+    DailySummary step{};
+    step.day = today_;
+
+    step.total_infections = (reference.total_infections + tally_.infections[lane]) * scale;
+    step.total_vaccinated = (reference.total_vaccinated + tally_.vaccinations[lane]) * scale;
+    step.vaccine_saves = (reference.vaccine_saves + tally_.vaccine_saves[lane]) * scale;
+    step.natural_saves = (reference.natural_saves + tally_.natural_saves[lane]) * scale;
+    step.never_infected = (reference.never_infected - tally_.first_infections[lane]) * scale;
+    step.total_delta_infections = (reference.total_delta_infections + tally_.delta_infections[lane]) * scale;
+    step.total_alpha_infections = (reference.total_alpha_infections + tally_.alpha_infections[lane]) * scale;
+    step.reinfections = (reference.reinfections + tally_.reinfections[lane]) * scale;
+    step.vaccinated_infections = (reference.vaccinated_infections + tally_.vaccinated_infections[lane]) * scale;
+    step.virus_carriers = static_cast<int>(infectious_counts_[lane]) * scale;
+
+    if (expensive) {
+        const auto &people = reference.people;
+        for (auto carrier : carriers_) {
+            Variant variant;
+            int symptom_onset;
+            if (Diverged(carrier)) {
+                const auto &record = Record(carrier);
+                if (!record.infectious[lane]) continue;
+                variant = static_cast<Variant>(record.variant[lane]);
+                symptom_onset = record.symptom_onset[lane];
+            } else {
+                const auto slot = people.Slot(carrier);
+                variant = people.hot.variant[slot];
+                symptom_onset = people.hot.symptom_onset[slot];
+            }
+            step.population_infectiousness += plan_->VariantInfo(variant).GetInfectivity(today_ - symptom_onset);
+        }
+        step.population_infectiousness *= scale;
+    }
+
+    return step;
+}
+
+void sim::LockstepSimulator::TraceCarrierContacts() {
+    const auto &people = reference_->people;
+    const int last_member = static_cast<int>(people.size()) - 1;
+    const std::array<uint32_t, 2> key{static_cast<uint32_t>(seed_), static_cast<uint32_t>(seed_ >> 32)};
+
+    thread_tallies_.Reset(*pool_);
+    const size_t grain = std::max(kMinCarrierChunk, carriers_.size() / (8 * pool_->Size()));
+    pool_->ParallelFor(0, carriers_.size(), grain, [&](size_t first, size_t last) {
+        std::uniform_int_distribution<int> selector_dist(0, last_member);
+        auto &tally = thread_tallies_.Local();
+        std::array<PendingContact, kContactBatch> pending;
+        size_t pending_count = 0;
+
+        for (size_t k = first; k < last; ++k) {
+            const size_t carrier = carriers_[k];
+
+            // Carriers without a record are infectious in every replica, with the reference's infectivity
+            LaneMask lanes;
+            Lanes<int32_t> curve_indices;
+            Lanes<uint8_t> variants;
+            if (Diverged(carrier)) {
+                const auto &record = Record(carrier);
+                lanes = InfectiousLanes(record, curve_indices);
+                variants = record.variant;
+            } else {
+                const auto slot = people.Slot(carrier);
+                const auto variant = people.hot.variant[slot];
+                const auto &infectivity = plan_->VariantInfo(variant).Properties().infectivity;
+                const auto curve_index = infectivity.Index(today_ - people.hot.symptom_onset[slot]);
+                if (infectivity.values[curve_index] <= 0)
+                    continue;
+
+                lanes = active_;
+                curve_indices.fill(curve_index);
+                variants.fill(static_cast<uint8_t>(variant));
+            }
+            if (!lanes)
+                continue;
+
+            // The first block of the carrier's stream in every replica, which differ only in their run
+            Philox4x32::CounterWords words;
+            words[0].fill(0);
+            words[1] = runs_;
+            words[2].fill(static_cast<uint32_t>(today_));
+            words[3].fill(static_cast<uint32_t>(carrier));
+            Philox4x32::Blocks(key, words);
+
+            for (; lanes; lanes &= lanes - 1) {
+                const auto l = static_cast<size_t>(std::countr_zero(lanes));
+                Probabilities prob(seed_, runs_[l], today_, static_cast<uint32_t>(carrier),
+                                   {words[0][l], words[1][l], words[2][l], words[3][l]});
+                const auto variant_index = variants[l];
+                const auto transmission_count =
+                    tables_[l].At(variant_index, static_cast<size_t>(curve_indices[l])).Sample(prob.UniformScalar());
+
+                for (int i = 0; i < transmission_count; ++i) {
+                    pending[pending_count++] = {static_cast<uint32_t>(selector_dist(prob.GetGenerator())),
+                                                static_cast<uint8_t>(l), variant_index};
+                    if (pending_count == kContactBatch) {
+                        ScreenContacts(pending.data(), pending_count, tally);
+                        pending_count = 0;
+                    }
+                }
+            }
+        }
+
+        ScreenContacts(pending.data(), pending_count, tally);
+    });
+
+    tally_ += thread_tallies_.Sum();
+}
+
+void sim::LockstepSimulator::ScreenContacts(const PendingContact *contacts, size_t count, LaneTally &tally) {
+    const auto &people = reference_->people;
+    for (size_t k = 0; k < count; ++k) {
+        people.PrefetchSlot(contacts[k].index);
+        plan_->variants[contacts[k].variant_index]->PrefetchPerson(people, contacts[k].index);
+    }
+
+    // The same screening as Simulator::ScreenContacts, against the replica's record if the member has one
+    for (size_t k = 0; k < count; ++k) {
+        const auto [index, lane, variant_index] = contacts[k];
+        const auto *info = plan_->variants[variant_index].get();
+        bool natural;
+        bool vaccine;
+        if (Diverged(index)) {
+            const auto &record = Record(index);
+            if (record.infectious[lane]) continue;
+            const LaneMask bit = LaneMask{1} << lane;
+            natural = (NaturalImmuneLanes(record, *info) & bit) != 0;
+            vaccine = !natural && (VaccineImmuneLanes(record, *info) & bit) != 0;
+        } else {
+            if (reference_->IsInfectious(index)) continue;
+            natural = info->IsPersonNatImmune(people, index, today_);
+            vaccine = !natural && info->IsPersonVaxImmune(people, index, today_);
+        }
+
+        if (natural) {
+            tally.natural_saves[lane]++;
+        } else if (vaccine) {
+            tally.vaccine_saves[lane]++;
+        } else {
+            claims_[lane].Claim(variant_index, index);
+        }
+    }
+}
+
+sim::LaneMask sim::LockstepSimulator::NaturalImmuneLanes(const LaneRecord &record,
+                                                          const VariantProbabilities &info) const {
+    if (info.HasNaturalWindows()) {
+        const auto &windows = record.natural_windows[VariantIndex(info.GetVariant()) - kFirstVariant];
+        return LanesBetween(windows.first, windows.last, today_);
+    }
+
+    LaneMask mask = 0;
+    for (LaneMask lanes = NonZeroLanes(record.variant); lanes; lanes &= lanes - 1) {
+        const auto l = static_cast<size_t>(std::countr_zero(lanes));
+        if (record.natural_immunity_scalar[l] <= info.GetNaturalImmunity(today_ - record.infected_day[l])) {
+            mask |= LaneMask{1} << l;
+        }
+    }
+    return mask;
+}
+
+sim::LaneMask sim::LockstepSimulator::VaccineImmuneLanes(const LaneRecord &record,
+                                                          const VariantProbabilities &info) const {
+    if (info.HasVaxWindows()) {
+        const auto &windows = record.vaccine_windows[VariantIndex(info.GetVariant()) - kFirstVariant];
+        return LanesBetween(windows.first, windows.last, today_);
+    }
+
+    LaneMask mask = 0;
+    for (LaneMask lanes = NonZeroLanes(record.is_vaccinated); lanes; lanes &= lanes - 1) {
+        const auto l = static_cast<size_t>(std::countr_zero(lanes));
+        if (record.vaccine_immunity_scalar[l] <= info.GetVaxImmunity(today_ - record.vaccination_day[l])) {
+            mask |= LaneMask{1} << l;
+        }
+    }
+    return mask;
+}
+
+void sim::LockstepSimulator::RemoveRecovered() {
+    const auto &people = reference_->people;
+    size_t kept = 0;
+    for (auto carrier : carriers_) {
+        if (!Diverged(carrier) && people.cold.recovery_day[people.Slot(carrier)] > today_) {
+            carriers_[kept++] = carrier;
+            continue;
+        }
+
+        auto &record = records_[Diverge(carrier)];
+        auto recovering = NonZeroLanes(record.infectious) & LanesBelow(record.recovery_day, today_ + 1) & active_;
+        for (; recovering; recovering &= recovering - 1) {
+            const auto l = static_cast<size_t>(std::countr_zero(recovering));
+            record.infectious[l] = 0;
+            record.recovery_day[l] = RecoveryWheel::kNoRecovery;
+            infectious_counts_[l]--;
+        }
+        if (NonZeroLanes(record.infectious) & active_) {
+            carriers_[kept++] = carrier;
+        }
+    }
+    carriers_.resize(kept);
+}
+
+void sim::LockstepSimulator::ApplyClaims() {
+    infections_.clear();
+    for (size_t l = 0; l < lane_count_; ++l) {
+        auto &claims = claims_[l];
+        for (size_t word = 0; word < claims.WordCount(); ++word) {
+            claims.Collect(word, [&](size_t index, size_t v) {
+                infections_.push_back({static_cast<uint32_t>(index), static_cast<uint8_t>(l),
+                                       static_cast<uint8_t>(v), 0.0, 0.0f, 0});
+            });
+        }
+    }
+
+    // Each infection's random values come from its member's position in its replica's infection stream, which are
+    // computed kLanes at a time, as in Simulator::ApplyClaims
+    for (size_t first = 0; first < infections_.size(); first += kLanes) {
+        const size_t count = std::min(kLanes, infections_.size() - first);
+        Lanes<uint32_t> runs{};
+        Lanes<uint32_t> positions{};
+        for (size_t i = 0; i < count; ++i) {
+            runs[i] = runs_[infections_[first + i].lane];
+            positions[i] = infections_[first + i].index;
+        }
+
+        auto pairs = Probabilities::UniformPairsAt(seed_, runs, today_, RandomStream::Infection, positions);
+        for (size_t i = 0; i < count; ++i) {
+            infections_[first + i].uniform = pairs[i][0];
+            infections_[first + i].scalar = static_cast<float>(pairs[i][1]);
+        }
+    }
+
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        variant_uniforms_.clear();
+        for (const auto &infection : infections_) {
+            if (infection.variant_index == v) variant_uniforms_.push_back(infection.uniform);
+        }
+
+        variant_incubations_.resize(variant_uniforms_.size());
+        plan_->variants[v]->SampleIncubations(variant_uniforms_.data(), variant_incubations_.data(),
+                                              variant_uniforms_.size());
+        size_t j = 0;
+        for (auto &infection : infections_) {
+            if (infection.variant_index == v) infection.incubation = variant_incubations_[j++];
+        }
+    }
+
+    // The same changes as Simulator::WriteInfection and RegisterInfection make, in the replica's lane of the record
+    for (const auto &infection : infections_) {
+        auto &record = records_[Diverge(infection.index)];
+        const size_t l = infection.lane;
+        const auto &variant = *plan_->variants[infection.variant_index];
+
+        if (record.variant[l] == static_cast<uint8_t>(Variant::None)) {
+            tally_.first_infections[l]++;
+        } else {
+            tally_.reinfections[l]++;
+        }
+        if (record.is_vaccinated[l]) {
+            tally_.vaccinated_infections[l]++;
+        }
+        tally_.infections[l]++;
+        if (variant.GetVariant() == Variant::Delta) tally_.delta_infections[l]++;
+        if (variant.GetVariant() == Variant::Alpha) tally_.alpha_infections[l]++;
+
+        // A member who isn't infectious in any replica isn't among the carriers yet
+        if (!(NonZeroLanes(record.infectious) & active_)) {
+            carriers_.push_back(infection.index);
+        }
+
+        record.variant[l] = static_cast<uint8_t>(variant.GetVariant());
+        record.infected_day[l] = today_;
+        record.symptom_onset[l] = today_ + infection.incubation;
+        record.natural_immunity_scalar[l] = static_cast<float>(StoredScalar(infection.scalar));
+        for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+            const auto &info = *plan_->variants[v];
+            if (info.HasNaturalWindows()) {
+                record.natural_windows[v - kFirstVariant].Set(
+                    l, info.NaturalImmunityWindow(record.natural_immunity_scalar[l], today_));
+            }
+        }
+        if (variant.RecoveryOffset() != VariantProbabilities::kNoRecovery) {
+            record.recovery_day[l] = record.symptom_onset[l] + variant.RecoveryOffset();
+        }
+        record.infectious[l] = 1;
+        infectious_counts_[l]++;
+    }
+}
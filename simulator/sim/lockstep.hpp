@@ -0,0 +1,241 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "infection_claims.hpp"
+#include "lanes.hpp"
+#include "per_thread.hpp"
+#include "plan.hpp"
+#include "population/person.hpp"
+#include "population/population.hpp"
+#include "population/slot_table.hpp"
+#include "thread_pool.hpp"
+#include "transmission_tables.hpp"
+
+namespace sim {
+
+    /** @class LockstepSimulator
+     *
+     * @brief An experimental engine which advances up to kLanes replicas of a population, each with its own contact
+     * probability and run, through the same days together
+     *
+     * @summary The replicas all branch off one reference population, which isn't copied. A member's record is only
+     * taken out of the reference once some replica modifies them, into a record which holds that member's fields for
+     * every replica side by side (replica-major: one Lanes vector per field). Members without such a record are read
+     * from the reference once for all the replicas, which is what makes the replicas cheaper together than apart:
+     *
+     *  - the vaccination scan, which passes over everyone vaccinated so far every day, is made once for all of them
+     *  - a carrier's infectivity is looked up once, and their streams for all the replicas are started with one
+     *    vectorized Philox evaluation (see Philox4x32::Blocks)
+     *  - branching off the reference only clears the records of the previous batch, where each replica would otherwise
+     *    restore every member it modified
+     *
+     * Records are compared, counted and updated a whole Lanes vector at a time (see lanes.hpp), which uses AVX2 when
+     * the build targets it. Records keep the immunity windows of People as well, so that a contact with a recorded
+     * member is screened against the windows of all the replicas at once, by the same method a Simulator uses.
+     *
+     * Replica l uses run `first_run + l` and gives exactly the results a Simulator gives with that run and its
+     * contact probability, using the per-carrier engine. The replicas' populations are never written out; what they
+     * hold is read through Changes, GetDailySummary and Member.
+     */
+    class LockstepSimulator {
+    public:
+        static constexpr size_t kLanes = kLaneCount;
+
+        /** @brief The changes made to each replica's counters since Start
+         */
+        struct LaneTally {
+            Lanes<int32_t> infections{};
+            Lanes<int32_t> first_infections{};
+            Lanes<int32_t> reinfections{};
+            Lanes<int32_t> vaccinated_infections{};
+            Lanes<int32_t> alpha_infections{};
+            Lanes<int32_t> delta_infections{};
+            Lanes<int32_t> natural_saves{};
+            Lanes<int32_t> vaccine_saves{};
+            Lanes<int32_t> vaccinations{};
+
+            LaneTally &operator+=(const LaneTally &other);
+        };
+
+        /** @brief Creates an engine for a plan whose days are split over `pool`, which must outlive it
+         */
+        LockstepSimulator(std::shared_ptr<const SimulationPlan> plan, ThreadPool &pool);
+
+        /** @brief Branches a replica off `reference` for each contact probability, up to kLanes, where replica l uses
+         * run `first_run + l`. The reference must not be modified until the replicas are done with it.
+         */
+        void Start(const Population &reference, std::span<const double> contact_probabilities, uint32_t first_run);
+
+        void ApplyVaccines();
+
+        /** @brief Simulates a day in every replica. If `summaries` is given, replica l's summary of the day goes in
+         * `summaries[l]`, the same as Simulator::SimulateDay returns.
+         */
+        void SimulateDay(std::span<DailySummary> summaries = {}, bool expensive_stats = false);
+
+        [[nodiscard]] inline size_t LaneCount() const { return lane_count_; }
+        [[nodiscard]] inline int Today() const { return today_; }
+        [[nodiscard]] inline const LaneTally &Changes() const { return tally_; }
+
+        /** @brief The same as Population::TotalInfections for a replica
+         */
+        [[nodiscard]] inline int TotalInfections(size_t lane) const {
+            return (reference_->total_infections + tally_.infections[lane]) * reference_->Scale();
+        }
+
+        [[nodiscard]] inline size_t InfectiousCount(size_t lane) const { return infectious_counts_[lane]; }
+
+        /** @brief The same as Simulator::GetDailySummary for a replica. The replica's population_infectiousness is
+         * summed in another order than a Simulator sums it, so it may differ from the Simulator's in the last bits.
+         */
+        [[nodiscard]] DailySummary GetDailySummary(size_t lane, bool expensive) const;
+
+        [[nodiscard]] bool IsInfectious(size_t lane, size_t index) const;
+
+        /** @brief A replica's copy of the member at `index`
+         */
+        [[nodiscard]] Person Member(size_t lane, size_t index) const;
+
+    private:
+        /** @brief The days [first, last] of a kind of immunity against a variant in every replica, the same range as
+         * an ImmunityWindow
+         */
+        struct LaneWindows {
+            Lanes<int32_t> first;
+            Lanes<int32_t> last;
+
+            void Set(size_t lane, ImmunityWindow window);
+        };
+
+        /** @brief A member's fields in every replica
+         */
+        struct alignas(32) LaneRecord {
+            Lanes<int32_t> infected_day;
+            Lanes<int32_t> symptom_onset;
+            Lanes<int32_t> vaccination_day;
+            Lanes<int32_t> recovery_day;
+            Lanes<float> natural_immunity_scalar;
+            Lanes<float> vaccine_immunity_scalar;
+            Lanes<uint8_t> variant;
+            Lanes<uint8_t> is_vaccinated;
+            Lanes<uint8_t> infectious;
+
+            // By VariantIndex - kFirstVariant, only kept up to date for the variants whose curves have windows (see
+            // VariantProbabilities::HasNaturalWindows and HasVaxWindows)
+            std::array<LaneWindows, kVariantCount - kFirstVariant> natural_windows;
+            std::array<LaneWindows, kVariantCount - kFirstVariant> vaccine_windows;
+        };
+
+        /** @brief A member reached by a transmission in one replica, waiting to be screened for immunity
+         */
+        struct PendingContact {
+            uint32_t index;
+            uint8_t lane;
+            uint8_t variant_index;
+        };
+
+        /** @brief A new infection in one replica
+         */
+        struct NewInfection {
+            uint32_t index;
+            uint8_t lane;
+            uint8_t variant_index;
+            double uniform;
+            float scalar;
+            int incubation;
+        };
+
+        static constexpr size_t kMinCarrierChunk = 256;
+        static constexpr size_t kContactBatch = 32;
+
+        std::shared_ptr<const SimulationPlan> plan_;
+        ThreadPool *pool_;
+        uint64_t seed_;
+
+        const Population *reference_{};
+        int today_{};
+        size_t lane_count_{};
+        LaneMask active_{};
+        Lanes<uint32_t> runs_{};
+        Lanes<int32_t> vaccinated_{};
+        std::array<size_t, kLanes> infectious_counts_{};
+        std::array<TransmissionTables, kLanes> tables_;
+        std::array<InfectionClaims, kLanes> claims_;
+
+        LaneTally tally_;
+        PerThread<LaneTally> thread_tallies_;
+
+        // Records of the members some replica has modified, found through a bit per member and then the table, and
+        // the member each one belongs to. Slot 0 is unused, since the table reserves it for members without a record.
+        std::vector<LaneRecord> records_;
+        std::vector<uint32_t> owners_;
+        SlotTable record_slots_;
+        std::vector<uint64_t> diverged_;
+
+        // A bit per member whose record is vaccinated in every replica, which the vaccination scan skips
+        std::vector<uint64_t> vaccinated_everywhere_;
+
+        // The members which are infectious in any replica
+        std::vector<size_t> carriers_;
+
+        // Every variant's infectivity curve laid end to end as flags of where it's positive, with each variant's
+        // offset, last index and start in the flags, for looking up the infectivity of all of a record's replicas
+        // at once
+        std::vector<int32_t> infectivity_positive_;
+        Lanes<int32_t> curve_offsets_{};
+        Lanes<int32_t> curve_last_{};
+        Lanes<int32_t> curve_starts_{};
+
+        std::vector<NewInfection> infections_;
+        std::vector<double> variant_uniforms_;
+        std::vector<int> variant_incubations_;
+
+        [[nodiscard]] inline bool Diverged(size_t index) const {
+            return (diverged_[index >> 6] >> (index & 63)) & 1;
+        }
+
+        [[nodiscard]] inline bool VaccinatedEverywhere(size_t index) const {
+            return (vaccinated_everywhere_[index >> 6] >> (index & 63)) & 1;
+        }
+
+        [[nodiscard]] inline const LaneRecord &Record(size_t index) const {
+            return records_[record_slots_.Find(index)];
+        }
+
+        /** @brief The slot of the record of the member at `index`, which is created from the reference if the member
+         * doesn't have one yet. Creating records may move all of them.
+         */
+        size_t Diverge(size_t index);
+
+        /** @brief The replicas in which a record's member is infectious with a positive infectivity today, with the
+         * point of the infectivity curve each of them is at
+         */
+        [[nodiscard]] LaneMask InfectiousLanes(const LaneRecord &record, Lanes<int32_t> &curve_indices) const;
+
+        /** @brief Finds the day's transmissions in every replica and claims their targets in each replica's claims
+         */
+        void TraceCarrierContacts();
+
+        /** @brief The replicas in which a record's member is immune to a variant today, checked the same way as
+         * VariantProbabilities::IsRecordNatImmune and IsRecordVaxImmune check a member of a population
+         */
+        [[nodiscard]] LaneMask NaturalImmuneLanes(const LaneRecord &record, const VariantProbabilities &info) const;
+        [[nodiscard]] LaneMask VaccineImmuneLanes(const LaneRecord &record, const VariantProbabilities &info) const;
+
+        void ScreenContacts(const PendingContact *contacts, size_t count, LaneTally &tally);
+
+        /** @brief Takes everyone whose infectious period ended today off the infectious set of each replica
+         */
+        void RemoveRecovered();
+
+        /** @brief Infects everyone who was claimed during the day in each replica
+         */
+        void ApplyClaims();
+    };
+
+}
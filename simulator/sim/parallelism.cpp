@@ -0,0 +1,35 @@
+#include "parallelism.hpp"
+
+sim::data::ParallelMode sim::ChooseParallelism(data::ParallelMode requested, size_t population_size, int run_count,
+                                               int threads) {
+    using data::ParallelMode;
+    if (requested != ParallelMode::Auto)
+        return requested;
+
+    // Nothing to share between threads at the run level
+    if (threads <= 1 || run_count <= 1)
+        return ParallelMode::Carriers;
+
+    // Every thread needs its own copy of the population
+    if (population_size * static_cast<size_t>(threads) > kMaxReplicatedPeople)
+        return ParallelMode::Carriers;
+
+    // With at least as many runs as threads every core stays busy without any per-day fork/join, and small
+    // populations don't have enough carriers per day to be worth splitting
+    if (run_count >= threads || population_size <= kSmallPopulation)
+        return ParallelMode::Runs;
+
+    return ParallelMode::Carriers;
+}
+
+const char *sim::ToString(data::ParallelMode mode) {
+    switch (mode) {
+    case data::ParallelMode::Auto:
+        return "auto";
+    case data::ParallelMode::Carriers:
+        return "carriers";
+    case data::ParallelMode::Runs:
+        return "runs";
+    }
+    return "unknown";
+}
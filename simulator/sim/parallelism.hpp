@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include "data.hpp"
+
+namespace sim {
+
+    /** @brief Populations at or below this many simulated people are too small for the per-day carrier loop to
+     * amortize splitting it over threads, so replicas are run concurrently instead whenever there's more than one
+     */
+    constexpr size_t kSmallPopulation = 1'000'000;
+
+    /** @brief Upper bound on the total number of person records held when every thread owns its own population
+     * copy for run-level parallelism (roughly 100 bytes each)
+     */
+    constexpr size_t kMaxReplicatedPeople = 100'000'000;
+
+    /** @brief Decides how to parallelize a set of independent replicas of a population
+     *
+     * @param requested the mode requested by the program options, anything other than Auto is returned unchanged
+     * @param population_size the number of simulated people in each replica
+     * @param run_count the number of replicas
+     * @param threads the number of threads available
+     */
+    data::ParallelMode ChooseParallelism(data::ParallelMode requested, size_t population_size, int run_count,
+                                         int threads);
+
+    const char *ToString(data::ParallelMode mode);
+
+}
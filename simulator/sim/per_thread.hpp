@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace sim {
+
+    /** @class PerThread
+     *
+     * @brief One copy of a value per thread of a ThreadPool, each on its own cache lines, for reductions which would
+     * otherwise go through shared atomics
+     *
+     * @summary Threads update their own copy through Local() without any synchronization, and without false sharing
+     * since no two copies share a cache line. The copies are combined with `+=` by Sum once the threads are done, so
+     * `T` is typically a plain struct of counters with an `operator+=`, but buffers that each thread reuses work just
+     * as well when Sum isn't needed.
+     */
+    template <typename T>
+    class PerThread {
+    public:
+        /** @brief Resets every copy to a value initialized `T`, with one copy for each thread of the pool
+         */
+        void Reset(const ThreadPool &pool) {
+            pool_ = &pool;
+            slots_.assign(pool.Size(), Slot{});
+        }
+
+        /** @brief The calling thread's copy, only valid on the threads of the pool last given to Reset
+         */
+        inline T &Local() { return slots_[pool_->WorkerIndex()].value; }
+
+        [[nodiscard]] inline size_t size() const { return slots_.size(); }
+        inline T &operator[](size_t thread) { return slots_[thread].value; }
+        inline const T &operator[](size_t thread) const { return slots_[thread].value; }
+
+        /** @brief Combines every thread's copy
+         */
+        [[nodiscard]] T Sum() const {
+            T total{};
+            for (const auto &slot : slots_) total += slot.value;
+            return total;
+        }
+
+    private:
+        struct alignas(kCacheLine) Slot {
+            T value{};
+        };
+
+        const ThreadPool *pool_{};
+        std::vector<Slot> slots_;
+    };
+
+}
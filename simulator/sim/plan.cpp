@@ -0,0 +1,83 @@
+#include "plan.hpp"
+#include <algorithm>
+#include <limits>
+
+std::shared_ptr<const sim::SimulationPlan> sim::CompilePlan(const data::ProgramInput &input) {
+    auto plan = std::make_shared<SimulationPlan>();
+    plan->state = input.state;
+    plan->state_info = input.state_info.at(input.state);
+    plan->options = input.options;
+    plan->population_scale = input.population_scale;
+    plan->seed = input.seed;
+
+    plan->variants[VariantIndex(Variant::Alpha)] =
+        std::make_unique<VariantProbabilities>(input.world_properties.alpha, Variant::Alpha);
+    plan->variants[VariantIndex(Variant::Delta)] =
+        std::make_unique<VariantProbabilities>(input.world_properties.delta, Variant::Delta);
+
+    const auto &infected = input.infected_history.at(input.state);
+    auto vax_it = input.vax_history.find(input.state);
+    auto variant_it = input.variant_history.find(input.state);
+
+    // The dense range has to cover the infection history, the vaccination history and the requested simulation
+    // period, including the vaccination look-ahead and the contact search check days
+    plan->history_first_day = std::numeric_limits<int>::max();
+    plan->history_last_day = std::numeric_limits<int>::min();
+    for (const auto &[day, _] : infected) {
+        plan->history_first_day = std::min(plan->history_first_day, day);
+        plan->history_last_day = std::max(plan->history_last_day, day);
+    }
+
+    int first = std::min(plan->history_first_day, data::ToReferenceDate(input.start_day));
+    int last = std::max(plan->history_last_day, data::ToReferenceDate(input.end_day) + 31);
+    if (vax_it != input.vax_history.end()) {
+        for (const auto &[day, _] : vax_it->second) {
+            first = std::min(first, day);
+            last = std::max(last, day);
+        }
+    }
+
+    // Every day a member records has to fit in the population's day columns, which are narrow in a packed build. The
+    // latest is the recovery of someone infected on the last day, after the longest incubation and infectious period.
+    int longest_infection = 0;
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        const auto &properties = plan->variants[v]->Properties();
+        longest_infection = std::max(longest_infection, static_cast<int>(properties.incubation.size() +
+                                                                          properties.infectivity.values.size()));
+    }
+    if (first < kMinStoredDay || static_cast<long>(last) + longest_infection >= kMaxStoredDay) {
+        throw std::out_of_range("Days " + std::to_string(first) + " to " + std::to_string(last) +
+                                " don't fit in the population's day columns");
+    }
+    if (plan->state_info.ages.size() > static_cast<size_t>(std::numeric_limits<StoredAge>::max()) + 1) {
+        throw std::out_of_range(std::to_string(plan->state_info.ages.size()) +
+                                " age buckets don't fit in the population's age column");
+    }
+
+    plan->first_day = first;
+    auto size = static_cast<size_t>(last - first + 1);
+    plan->total_infections.assign(size, SimulationPlan::kNoRecord);
+    plan->total_completed_vax.assign(size, SimulationPlan::kNoRecord);
+    plan->variant_fractions.resize(size);
+
+    for (const auto &[day, record] : infected) {
+        plan->total_infections[day - first] = record.total_infections;
+    }
+
+    if (vax_it != input.vax_history.end()) {
+        for (const auto &[day, record] : vax_it->second) {
+            plan->total_completed_vax[day - first] = record.total_completed_vax;
+        }
+    }
+
+    static const std::vector<data::VariantRecord> kNoVariantHistory;
+    const auto &variant_history = variant_it != input.variant_history.end() ? variant_it->second : kNoVariantHistory;
+    for (size_t i = 0; i < size; ++i) {
+        plan->variant_fractions[i].fill(0);
+        for (const auto &[variant, fraction] : data::GetVariantFractions(first + static_cast<int>(i), variant_history)) {
+            plan->variant_fractions[i][VariantIndex(variant)] = fraction;
+        }
+    }
+
+    return plan;
+}
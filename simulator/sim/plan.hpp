@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "covid.hpp"
+#include "data.hpp"
+#include "variant_probabilities.hpp"
+
+namespace sim {
+
+    /** @brief Per-variant probability models, indexed by VariantIndex. The Variant::None entry is empty.
+     */
+    using VariantTable = std::array<std::unique_ptr<const VariantProbabilities>, kVariantCount>;
+
+    /** @brief Fraction of new infections attributed to each variant, indexed by VariantIndex
+     */
+    using VariantFractions = std::array<double, kVariantCount>;
+
+    /** @struct SimulationPlan
+     *
+     * @brief An immutable, dense form of the program input for the selected state
+     *
+     * @summary The plan is compiled once after the input is loaded and shared read-only by every run and thread. All
+     * of the per-day history the simulation needs is flattened into arrays indexed by `day - first_day`, and the
+     * variant models live in a table indexed by the Variant enum, so nothing on the per-day path hashes, allocates or
+     * compares strings.
+     */
+    struct SimulationPlan {
+    public:
+        /** @brief Sentinel for days which have no record in a history array
+         */
+        static constexpr int kNoRecord = -1;
+
+        std::string state;
+        data::StateInfo state_info;
+        data::ProgramOptions options;
+        int population_scale{};
+        uint64_t seed{};
+
+        /** @brief First and last day (inclusive, reference date integers) of the infection history
+         */
+        int history_first_day{};
+        int history_last_day{};
+
+        /** @brief First day covered by the dense arrays below
+         */
+        int first_day{};
+
+        std::vector<int> total_infections;
+        std::vector<int> total_completed_vax;
+        std::vector<VariantFractions> variant_fractions;
+
+        VariantTable variants;
+
+        [[nodiscard]] inline const VariantProbabilities &VariantInfo(Variant v) const {
+            return *variants[VariantIndex(v)];
+        }
+
+        [[nodiscard]] inline bool InRange(int day) const {
+            return day >= first_day && day - first_day < static_cast<int>(total_infections.size());
+        }
+
+        [[nodiscard]] inline bool HasInfections(int day) const {
+            return InRange(day) && total_infections[day - first_day] != kNoRecord;
+        }
+
+        /** @brief Gets the estimated total number of infections on a day, throwing std::out_of_range if the infection
+         * history has no record of that day
+         */
+        [[nodiscard]] inline int TotalInfections(int day) const {
+            if (!HasInfections(day))
+                throw std::out_of_range("No infection history for day " + std::to_string(day));
+            return total_infections[day - first_day];
+        }
+
+        /** @brief Gets the total number of completed vaccinations on a day, or kNoRecord if there is none
+         */
+        [[nodiscard]] inline int TotalCompletedVax(int day) const {
+            return InRange(day) ? total_completed_vax[day - first_day] : kNoRecord;
+        }
+
+        /** @brief Gets the variant fractions valid on a day. Days outside of the plan use the nearest covered day.
+         */
+        [[nodiscard]] inline const VariantFractions &VariantFractionsOn(int day) const {
+            auto offset = std::clamp(day - first_day, 0, static_cast<int>(variant_fractions.size()) - 1);
+            return variant_fractions[offset];
+        }
+    };
+
+    /** @brief Compiles the program input for its selected state into a simulation plan
+     */
+    std::shared_ptr<const SimulationPlan> CompilePlan(const data::ProgramInput &input);
+
+}
@@ -0,0 +1,127 @@
+#include "people.hpp"
+#include <algorithm>
+
+void sim::People::Resize(size_t size) {
+    size_ = size;
+    if (sparse_) {
+        // Everyone starts out on the shared defaults
+        slots_.Clear();
+        owners_.assign(1, 0);
+        ResizeColumns(1);
+    } else {
+        ResizeColumns(size);
+    }
+}
+
+void sim::People::ResizeColumns(size_t slots) {
+    hot.variant.resize(slots, Variant::None);
+    hot.infected_day.resize(slots);
+    hot.symptom_onset.resize(slots);
+    hot.natural_immunity_scalar.resize(slots);
+    hot.vaccine_immunity_scalar.resize(slots);
+    hot.is_vaccinated.resize(slots);
+    hot.vaccination_day.resize(slots);
+    hot.infectious_slot.resize(slots, kNotInfectious);
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        hot.natural_window[v].resize(slots);
+        hot.vaccine_window[v].resize(slots);
+    }
+    cold.test_day.resize(slots);
+    cold.recovery_day.resize(slots, kMaxStoredDay);
+    cold.recovery_slot.resize(slots);
+}
+
+void sim::People::AssignAges(const std::vector<size_t> &counts) {
+    age_ends_.clear();
+    size_t end = 0;
+    for (auto count : counts) {
+        end += count;
+        age_ends_.push_back(end);
+    }
+}
+
+void sim::People::Reset() {
+    if (sparse_) {
+        Resize(size_);
+        return;
+    }
+
+    std::fill(hot.variant.begin(), hot.variant.end(), Variant::None);
+    std::fill(hot.infected_day.begin(), hot.infected_day.end(), 0);
+    std::fill(hot.symptom_onset.begin(), hot.symptom_onset.end(), 0);
+    std::fill(hot.natural_immunity_scalar.begin(), hot.natural_immunity_scalar.end(), 0.f);
+    std::fill(hot.vaccine_immunity_scalar.begin(), hot.vaccine_immunity_scalar.end(), 0.f);
+    std::fill(hot.is_vaccinated.begin(), hot.is_vaccinated.end(), 0);
+    std::fill(hot.vaccination_day.begin(), hot.vaccination_day.end(), 0);
+    std::fill(hot.infectious_slot.begin(), hot.infectious_slot.end(), kNotInfectious);
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        std::fill(hot.natural_window[v].begin(), hot.natural_window[v].end(), ImmunityWindow{});
+        std::fill(hot.vaccine_window[v].begin(), hot.vaccine_window[v].end(), ImmunityWindow{});
+    }
+    std::fill(cold.test_day.begin(), cold.test_day.end(), 0);
+    std::fill(cold.recovery_day.begin(), cold.recovery_day.end(), kMaxStoredDay);
+    std::fill(cold.recovery_slot.begin(), cold.recovery_slot.end(), 0);
+}
+
+void sim::People::CopyMember(const People &other, size_t i) {
+    // A member who has no slot in the other sparse set of people goes back to the shared defaults, so that the slots
+    // here don't pile up over many copies
+    const auto from = other.Slot(i);
+    if (sparse_ && other.sparse_ && from == SlotTable::kNoSlot) {
+        ReleaseSlot(i);
+        return;
+    }
+
+    const auto to = Touch(i);
+    hot.variant[to] = other.hot.variant[from];
+    hot.infected_day[to] = other.hot.infected_day[from];
+    hot.symptom_onset[to] = other.hot.symptom_onset[from];
+    hot.natural_immunity_scalar[to] = other.hot.natural_immunity_scalar[from];
+    hot.vaccine_immunity_scalar[to] = other.hot.vaccine_immunity_scalar[from];
+    hot.is_vaccinated[to] = other.hot.is_vaccinated[from];
+    hot.vaccination_day[to] = other.hot.vaccination_day[from];
+    hot.infectious_slot[to] = other.hot.infectious_slot[from];
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        hot.natural_window[v][to] = other.hot.natural_window[v][from];
+        hot.vaccine_window[v][to] = other.hot.vaccine_window[v][from];
+    }
+    cold.test_day[to] = other.cold.test_day[from];
+    cold.recovery_day[to] = other.cold.recovery_day[from];
+    cold.recovery_slot[to] = other.cold.recovery_slot[from];
+}
+
+void sim::People::ReleaseSlot(size_t index) {
+    if (!sparse_) return;
+    auto slot = slots_.Find(index);
+    if (slot == SlotTable::kNoSlot) return;
+
+    // The owners are among the columns of sparse storage, so they move along with the record
+    const auto last = SlotCount() - 1;
+    const auto moved = owners_[last];
+    ForEachColumn([&](auto &column) {
+        column[slot] = column[last];
+        column.pop_back();
+    });
+    slots_.Erase(index);
+    if (slot != last) slots_.Update(moved, slot);
+}
+
+void sim::People::ResizeSlots(size_t slots) {
+    ResizeColumns(slots);
+    if (sparse_) owners_.resize(slots);
+}
+
+void sim::People::RebuildSlotTable() {
+    slots_.Clear();
+    for (size_t slot = FirstMemberSlot(); slot < owners_.size(); ++slot) {
+        slots_.Insert(owners_[slot], static_cast<uint32_t>(slot));
+    }
+}
+
+size_t sim::People::AddSlot(size_t index) {
+    auto slot = SlotCount();
+    ResizeColumns(slot + 1);
+    owners_.push_back(static_cast<uint32_t>(index));
+    slots_.Insert(index, static_cast<uint32_t>(slot));
+    return slot;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "person.hpp"
+#include "slot_table.hpp"
+
+namespace sim {
+
+    /** @class People
+     *
+     * @brief Columnar (structure-of-arrays) storage for the members of a population
+     *
+     * @summary Each field of a Person lives in its own contiguous array. The fields read on every contact check in
+     * the simulation loop are grouped in `hot`, while rarely read fields are kept apart in `cold` so that random
+     * lookups into the population only pull in the cache lines they actually need. Indexing returns a PersonRef
+     * (mutable) or a Person (const) so that code can still treat a member as a single record. The columns are kept in
+     * the storage types of storage.hpp, which are narrower in a DELTA_SIM_PACKED build.
+     *
+     * The columns are indexed by slot rather than by member. Normally every member has the slot equal to their index,
+     * but sparse storage only gives a slot to members who have been touched (written through Touch), which are found
+     * through a SlotTable. Everyone else shares the record in slot 0, which holds the defaults and is never written.
+     * Memory and copies then scale with the number of members the epidemic has reached rather than with the census,
+     * at the price of a table lookup for every access. Ages aren't stored at all: members are laid out by age bucket,
+     * so a member's age follows from their index.
+     */
+    class People {
+    public:
+        /** @brief Value of the infectious_slot column for members who aren't in the infectious set
+         */
+        static constexpr uint32_t kNotInfectious = UINT32_MAX;
+
+        struct HotColumns {
+            std::vector<Variant> variant;
+            std::vector<StoredDay> infected_day;
+            std::vector<StoredDay> symptom_onset;
+            std::vector<StoredScalar> natural_immunity_scalar;
+            std::vector<StoredScalar> vaccine_immunity_scalar;
+            std::vector<uint8_t> is_vaccinated;
+            std::vector<StoredDay> vaccination_day;
+
+            /** @brief Each member's position in the population's list of infectious members, or kNotInfectious
+             */
+            std::vector<uint32_t> infectious_slot;
+
+            /** @brief Days on which each member is protected against each variant by natural or vaccine immunity,
+             * indexed by VariantIndex and then by slot. Only filled for variants whose immunity curves allow it, see
+             * VariantProbabilities.
+             */
+            std::array<std::vector<ImmunityWindow>, kVariantCount> natural_window;
+            std::array<std::vector<ImmunityWindow>, kVariantCount> vaccine_window;
+        };
+
+        struct ColdColumns {
+            std::vector<StoredDay> test_day;
+
+            /** @brief The day each member stops being infectious and their entry's position in that day's bucket,
+             * maintained by RecoveryWheel
+             */
+            std::vector<StoredDay> recovery_day;
+            std::vector<uint32_t> recovery_slot;
+        };
+
+        HotColumns hot;
+        ColdColumns cold;
+
+        /** @brief The bytes each record takes across all of the columns above. A DELTA_SIM_PACKED build narrows the
+         * fields of a Person to 16 bytes, but a record also holds the member's places in the infectious set and the
+         * recovery wheel, which index lists as long as the population and stay 32 bit, and an immunity window per
+         * variant for each kind of immunity. That comes to 40 bytes instead of 70 in a full build.
+         */
+        static constexpr size_t kBytesPerRecord = sizeof(Variant) + 5 * sizeof(StoredDay) + 2 * sizeof(StoredScalar) +
+                                                  sizeof(uint8_t) + 2 * sizeof(uint32_t) +
+                                                  2 * (kVariantCount - kFirstVariant) * sizeof(ImmunityWindow);
+
+        explicit People(bool sparse = false) : sparse_(sparse) {}
+
+        [[nodiscard]] inline size_t size() const { return size_; }
+        [[nodiscard]] inline bool empty() const { return size_ == 0; }
+        [[nodiscard]] inline bool IsSparse() const { return sparse_; }
+
+        /** @brief The number of records in the columns, which is size() unless the storage is sparse
+         */
+        [[nodiscard]] inline size_t SlotCount() const { return hot.variant.size(); }
+
+        /** @brief The slot holding the record of the member at `index`, for reading
+         */
+        [[nodiscard]] inline size_t Slot(size_t index) const { return sparse_ ? slots_.Find(index) : index; }
+
+        /** @brief The slot holding the record of the member at `index`, for writing. In sparse storage this gives the
+         * member a slot of their own if they don't have one yet, which may move every column, so it must not be
+         * called while other threads read the columns.
+         */
+        inline size_t Touch(size_t index) {
+            if (!sparse_) return index;
+            auto slot = slots_.Find(index);
+            return slot != SlotTable::kNoSlot ? slot : AddSlot(index);
+        }
+
+        /** @brief The index of the member whose record is in `slot`, undefined for slot 0 of sparse storage
+         */
+        [[nodiscard]] inline size_t Member(size_t slot) const { return sparse_ ? owners_[slot] : slot; }
+
+        /** @brief The first slot which belongs to a member, skipping the shared defaults of sparse storage
+         */
+        [[nodiscard]] inline size_t FirstMemberSlot() const { return sparse_ ? 1 : 0; }
+
+        /** @brief Starts loading what Slot will read first for the member at `index`
+         */
+        inline void PrefetchSlot(size_t index) const {
+            if (sparse_) {
+                slots_.Prefetch(index);
+            } else {
+                __builtin_prefetch(&hot.infectious_slot[index]);
+            }
+        }
+
+        [[nodiscard]] inline StoredAge Age(size_t index) const {
+            auto bucket = std::upper_bound(age_ends_.begin(), age_ends_.end(), index) - age_ends_.begin();
+            return static_cast<StoredAge>(bucket);
+        }
+
+        /** @brief A mutable view of a member's record, which touches them (see Touch)
+         */
+        inline PersonRef operator[](size_t i) {
+            auto slot = Touch(i);
+            return {hot.variant[slot],
+                    hot.infected_day[slot],
+                    hot.symptom_onset[slot],
+                    cold.test_day[slot],
+                    hot.natural_immunity_scalar[slot],
+                    hot.vaccine_immunity_scalar[slot],
+                    hot.is_vaccinated[slot],
+                    hot.vaccination_day[slot],
+                    Age(i)};
+        }
+
+        inline Person operator[](size_t i) const {
+            auto slot = Slot(i);
+            Person p;
+            p.variant = hot.variant[slot];
+            p.infected_day = hot.infected_day[slot];
+            p.symptom_onset = hot.symptom_onset[slot];
+            p.test_day = cold.test_day[slot];
+            p.natural_immunity_scalar = hot.natural_immunity_scalar[slot];
+            p.vaccine_immunity_scalar = hot.vaccine_immunity_scalar[slot];
+            p.is_vaccinated = hot.is_vaccinated[slot];
+            p.vaccination_day = hot.vaccination_day[slot];
+            p.age = Age(i);
+            return p;
+        }
+
+        /** @summary Resizes to `size` members, new members are default initialized
+         */
+        void Resize(size_t size);
+
+        /** @summary Lays the members out by age bucket, with `counts[k]` members in bucket k
+         */
+        void AssignAges(const std::vector<size_t> &counts);
+
+        /** @summary Resets every member's parameters (except age) to the defaults
+         */
+        void Reset();
+
+        /** @summary Overwrites all fields of the member at position i with those of the member at the same position
+         * in another set of people. If both are sparse and the member has no slot in the other one, they lose their
+         * slot here as well.
+         */
+        void CopyMember(const People &other, size_t i);
+
+        /** @summary Sends the member at `index` back to the shared defaults of sparse storage, freeing their slot. The
+         * record in the last slot moves into it, so slots are only stable until the next release.
+         */
+        void ReleaseSlot(size_t index);
+
+        /** @summary Sets the number of slots, for when the columns are about to be filled in from elsewhere
+         */
+        void ResizeSlots(size_t slots);
+
+        /** @summary Rebuilds the table of sparse storage from the owners of the slots, once they were filled in
+         */
+        void RebuildSlotTable();
+
+        /** @brief Calls `column(values)` with every column's vector in a fixed order, followed by the owners of the
+         * slots in sparse storage
+         */
+        template <typename F>
+        void ForEachColumn(F &&column) { ForEachColumnOf(*this, column); }
+
+        template <typename F>
+        void ForEachColumn(F &&column) const { ForEachColumnOf(*this, column); }
+
+        /** @brief The member of each slot of sparse storage, empty otherwise
+         */
+        inline std::vector<uint32_t> &Owners() { return owners_; }
+        inline const std::vector<uint32_t> &Owners() const { return owners_; }
+
+    private:
+        bool sparse_{};
+        size_t size_{};
+        SlotTable slots_;
+        std::vector<uint32_t> owners_;
+
+        // One past the last member of each age bucket
+        std::vector<size_t> age_ends_;
+
+        size_t AddSlot(size_t index);
+        void ResizeColumns(size_t slots);
+
+        template <typename Self, typename F>
+        static void ForEachColumnOf(Self &self, F &column) {
+            column(self.hot.variant);
+            column(self.hot.infected_day);
+            column(self.hot.symptom_onset);
+            column(self.hot.natural_immunity_scalar);
+            column(self.hot.vaccine_immunity_scalar);
+            column(self.hot.is_vaccinated);
+            column(self.hot.vaccination_day);
+            column(self.hot.infectious_slot);
+            for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+                column(self.hot.natural_window[v]);
+                column(self.hot.vaccine_window[v]);
+            }
+            column(self.cold.test_day);
+            column(self.cold.recovery_day);
+            column(self.cold.recovery_slot);
+            if (self.sparse_) column(self.owners_);
+        }
+    };
+
+#ifdef DELTA_SIM_PACKED
+    static_assert(People::kBytesPerRecord == 40);
+#else
+    static_assert(People::kBytesPerRecord == 70);
+#endif
+
+}
@@ -10,3 +10,28 @@ void sim::Person::Reset() {
     is_vaccinated = false;
     vaccination_day = 0;
 }
+
+void sim::PersonRef::Reset() {
+    variant = Variant::None;
+    infected_day = 0;
+    symptom_onset = 0;
+    test_day = 0;
+    natural_immunity_scalar = 0;
+    vaccine_immunity_scalar = 0;
+    is_vaccinated = false;
+    vaccination_day = 0;
+}
+
+sim::PersonRef::operator Person() const {
+    Person p;
+    p.variant = variant;
+    p.infected_day = infected_day;
+    p.symptom_onset = symptom_onset;
+    p.test_day = test_day;
+    p.natural_immunity_scalar = natural_immunity_scalar;
+    p.vaccine_immunity_scalar = vaccine_immunity_scalar;
+    p.is_vaccinated = is_vaccinated;
+    p.vaccination_day = vaccination_day;
+    p.age = age;
+    return p;
+}
@@ -7,38 +7,43 @@ namespace sim {
 
     /** @struct Person
      *
-     * @summary This struct is a data-only representation of a single member of a population
+     * @summary This struct is a data-only representation of a single member of a population. The population itself
+     * stores its members column-wise (see People), so a Person is a detached copy of one member's values. Fields are
+     * ordered widest first, so that in a DELTA_SIM_PACKED build a Person has no padding and fits in 16 bytes. The
+     * columns also keep bookkeeping which isn't part of a Person, so a member takes more than that in a population.
      */
     struct Person {
     public:
-        /** @summary What variant of SARS-CoV-2 the individual is carrying.
-         */
-        Variant variant{Variant::None};
-
         /** @summary On what day was the individual infected with the variant they're currently carrying
          */
-        int infected_day{};
+        StoredDay infected_day{};
 
         /** @summary On what day does the individual's symptoms manifest
          */
-        int symptom_onset{};
+        StoredDay symptom_onset{};
 
-        int test_day{};
+        StoredDay test_day{};
+        StoredDay vaccination_day{};
 
         /** @summary A scalar value unique to this individual, randomly generated at the time of infection, which
          * when combined with the natural immunity curves determines the binary immunity.
          */
-        float natural_immunity_scalar{};
+        StoredScalar natural_immunity_scalar{};
 
         /** @summary A scalar value unique to this individual, randomly generated at the time of vaccinations, which
          * when combined with the vaccine immunity curve determines the binary immunity.
          */
-        float vaccine_immunity_scalar{};
+        StoredScalar vaccine_immunity_scalar{};
+
+        /** @summary What variant of SARS-CoV-2 the individual is carrying.
+         */
+        Variant variant{Variant::None};
 
         bool is_vaccinated{};
-        int vaccination_day{};
 
-        int age{};
+        /** @summary Index of the individual's bucket in StateInfo::ages
+         */
+        StoredAge age{};
 
 
         /** @summary Gets whether or not the individual is carrying a variant
@@ -52,4 +57,39 @@ namespace sim {
 
     };
 
-}
\ No newline at end of file
+#ifdef DELTA_SIM_PACKED
+    static_assert(sizeof(Person) <= 16);
+#endif
+
+    /** @struct PersonRef
+     *
+     * @summary A mutable view of a single member of a columnar population. Each field is a reference into the
+     * population's storage, so code written against Person (e.g. `people[i].variant = ...`) works unchanged.
+     */
+    struct PersonRef {
+    public:
+        Variant &variant;
+        StoredDay &infected_day;
+        StoredDay &symptom_onset;
+        StoredDay &test_day;
+        StoredScalar &natural_immunity_scalar;
+        StoredScalar &vaccine_immunity_scalar;
+        uint8_t &is_vaccinated;
+        StoredDay &vaccination_day;
+
+        /** @summary Ages follow from the member's position in the population, so this is a copy
+         */
+        StoredAge age;
+
+        [[nodiscard]] inline bool IsInfected() const { return variant != Variant::None; }
+
+        /** @summary Resets all of the individual's parameters (except age) to the defaults
+         */
+        void Reset();
+
+        /** @summary Copies the referenced values out into a detached Person
+         */
+        [[nodiscard]] operator Person() const;
+    };
+
+}
@@ -1,18 +1,32 @@
 #include "population.hpp"
 #include "../timer.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <stdexcept>
 
-sim::Population::Population(int unscaled_size, int scale, const std::vector<double>& ages) {
+namespace {
+    uint64_t NextBulkRevision() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+}
+
+sim::Population::Population(int unscaled_size, int scale, const std::vector<double>& ages, bool sparse)
+    : people(sparse) {
     scale_ = scale;
     long scaled_population = static_cast<long>(std::round(static_cast<double>(unscaled_size) / scale));
 
-    for (int age = 0; age < ages.size(); age++) {
-        auto scaled_count = static_cast<long>(std::round(static_cast<double>(scaled_population) * ages[age]));
-        for (int i = 0; i < scaled_count; i++) {
-            people.emplace_back();
-            people.back().age = age;
-        }
+    std::vector<size_t> counts;
+    size_t total = 0;
+    for (double age_fraction : ages) {
+        counts.push_back(static_cast<size_t>(std::round(static_cast<double>(scaled_population) * age_fraction)));
+        total += counts.back();
     }
+
+    bulk_revision_ = NextBulkRevision();
+    people.Resize(total);
+    people.AssignAges(counts);
 }
 
 void sim::Population::Reset() {
@@ -27,15 +41,22 @@ void sim::Population::Reset() {
     reinfections = 0;
     vaccinated_infections = 0;
 
-    infectious_ptr_ = 0;
+    infectious_.clear();
 
-    for (auto &p : people)
-        p.Reset();
+    people.Reset();
+    recoveries_.Clear();
+    Invalidate();
+}
+
+void sim::Population::Invalidate() {
+    bulk_revision_ = NextBulkRevision();
+    copy_source_ = nullptr;
+    dirty_overflow_ = true;
 }
 
 void sim::Population::CopyFrom(const Population &other) {
     if (people.size() != other.people.size()) {
-        // Throw exception
+        throw std::invalid_argument("Cannot copy a population of a different size");
     }
 
     today = other.today;
@@ -48,37 +69,91 @@ void sim::Population::CopyFrom(const Population &other) {
     total_alpha_infections = other.total_alpha_infections;
     reinfections = other.reinfections;
     vaccinated_infections = other.vaccinated_infections;
-    infectious_ptr_ = other.infectious_ptr_;
+    infectious_ = other.infectious_;
     scale_ = other.scale_;
+    recoveries_ = other.recoveries_;
+    bulk_revision_ = NextBulkRevision();
+
+    bool can_restore = copy_source_ == &other &&
+                       copy_source_revision_ == other.bulk_revision_ &&
+                       copy_source_modifications_ == other.modifications_ &&
+                       !dirty_overflow_ &&
+                       people.IsSparse() == other.people.IsSparse();
+
+    if (can_restore) {
+        for (auto index : dirty_) {
+            people.CopyMember(other.people, index);
+            dirty_flags_[index] = 0;
+        }
+    } else {
+        // These are stl container assignments, which should efficiently make deep copies
+        // of the container and its contents
+        people = other.people;
+        dirty_flags_.assign(people.size(), 0);
+    }
 
-    // These are stl container assignments, which should efficiently make deep copies
-    // of the container and its contents
-    people = other.people;
+    dirty_.clear();
+    dirty_overflow_ = false;
+    copy_source_ = &other;
+    copy_source_revision_ = other.bulk_revision_;
+    copy_source_modifications_ = other.modifications_;
 }
 
-void sim::Population::AddToInfected(size_t current_index) {
-    // If they're already infectious, we do nothing
-    if (current_index < infectious_ptr_) return;
+void sim::Population::MarkDirty(size_t index) {
+    modifications_++;
+    if (dirty_overflow_ || dirty_flags_[index]) return;
 
-    // If they aren't sitting at the pointer position already, we swap them into place
-    if (current_index != infectious_ptr_) {
-        std::swap(people[current_index], people[infectious_ptr_]);
+    if (dirty_.size() >= people.size() / kDirtyLimitDivisor) {
+        dirty_overflow_ = true;
+        dirty_.clear();
+        return;
     }
 
-    // Finally, we advance the pointer
-    infectious_ptr_++;
+    dirty_flags_[index] = 1;
+    dirty_.push_back(index);
+}
+
+const std::vector<size_t> *sim::Population::ModifiedSinceCopy(const Population &source) const {
+    bool tracking = copy_source_ == &source &&
+                    copy_source_revision_ == source.bulk_revision_ &&
+                    copy_source_modifications_ == source.modifications_ &&
+                    !dirty_overflow_;
+    return tracking ? &dirty_ : nullptr;
+}
+
+void sim::Population::AddToInfected(size_t index) {
+    // If they're already infectious, we do nothing
+    if (IsInfectious(index)) return;
+
+    people.hot.infectious_slot[people.Touch(index)] = static_cast<uint32_t>(infectious_.size());
+    infectious_.push_back(index);
+    MarkDirty(index);
 }
 
-void sim::Population::RemoveFromInfected(size_t current_index) {
+void sim::Population::RemoveFromInfected(size_t index) {
     // if they're not infectious, we do nothing
-    if (current_index >= infectious_ptr_) return;
+    if (!IsInfectious(index)) return;
 
-    // We decrement the pointer, which will now very briefly point at someone who is infectious but will be swapped
-    // with someone who isn't
-    infectious_ptr_--;
+    // The last entry in the list takes over the removed member's slot
+    auto slot = people.hot.infectious_slot[people.Slot(index)];
+    auto last = infectious_.back();
+    infectious_[slot] = last;
+    people.hot.infectious_slot[people.Slot(last)] = slot;
+    infectious_.pop_back();
+    people.hot.infectious_slot[people.Slot(index)] = People::kNotInfectious;
+    MarkDirty(last);
+    MarkDirty(index);
+}
 
-    // If they're not already sitting at the pointer position we swap them with the individual who is
-    if (current_index != infectious_ptr_) {
-        std::swap(people[current_index], people[infectious_ptr_]);
+void sim::Population::RebuildInfectious(size_t count) {
+    infectious_.assign(count, 0);
+    for (size_t slot = people.FirstMemberSlot(); slot < people.SlotCount(); ++slot) {
+        auto infectious_slot = people.hot.infectious_slot[slot];
+        if (infectious_slot != People::kNotInfectious) infectious_[infectious_slot] = people.Member(slot);
     }
 }
+
+void sim::Population::ScheduleRecovery(size_t index, int day) {
+    recoveries_.Schedule(people, index, day, today);
+    MarkDirty(index);
+}
@@ -1,14 +1,25 @@
 #pragma once
 
+#include <cstdint>
 #include <optional>
 #include <vector>
-#include "person.hpp"
+#include "people.hpp"
+#include "recovery_wheel.hpp"
 
 namespace sim {
 
+    /** @brief Once more than one member in this many has been modified, restoring them one at a time from scattered
+     * positions is slower than copying every column in bulk
+     */
+    constexpr size_t kDirtyLimitDivisor = 16;
+
     /** @class Population
      *
      * @brief Is a data-only representation of a population of individuals at a given time.
+     *
+     * @summary Members never move within `people`. The infectious ones are listed by index in a dense array, and each
+     * member's position in that array is kept in the infectious_slot column, so that members can be added to and
+     * removed from the infectious set in O(1) without touching anyone else's record.
      */
     class Population {
     public:
@@ -17,20 +28,69 @@ namespace sim {
          * @param unscaled_size the number of people in the population *before* scaling
          * @param scale an integer that defines how many people in the real population are represented by each
          * simulated individual, also can be thought of as the model being built to a 1:scale scale
+         * @param sparse whether to only store the records of members who have been touched (see People)
          */
-        Population(int unscaled_size, int scale, const std::vector<double>& ages);
+        Population(int unscaled_size, int scale, const std::vector<double>& ages, bool sparse = false);
 
         void Reset();
+
+        /** @brief Makes this population a copy of another one
+         *
+         * @summary If the last copy was made from the same population, and that population hasn't been modified
+         * since, only the members that were marked dirty here in the meantime are restored. Otherwise (or once too
+         * many members are dirty for that to pay off) the whole set of people is copied. Throws
+         * std::invalid_argument if the other population has a different number of members.
+         */
         void CopyFrom(const Population& other);
-        void AddToInfected(size_t current_index);
-        void RemoveFromInfected(size_t current_index);
+
+        /** @brief Records that the member at an index was modified, so that CopyFrom knows to restore it. Anything
+         * that writes to `people` directly, other than through Reset and CopyFrom, must call this for every member
+         * it changes.
+         */
+        void MarkDirty(size_t index);
+
+        /** @brief The members modified since this population was last copied from `source`, or nullptr if it wasn't,
+         * if `source` has been modified since, or if too many members were modified to keep track of them
+         */
+        [[nodiscard]] const std::vector<size_t> *ModifiedSinceCopy(const Population &source) const;
+
+        void AddToInfected(size_t index);
+        void RemoveFromInfected(size_t index);
+
+        /** @brief Schedules the member at `index` to be removed from the infectious set on `day`
+         */
+        void ScheduleRecovery(size_t index, int day);
+
+        /** @brief Removes everyone scheduled to stop being infectious on or before today from the infectious set,
+         * calling `before_remove(index)` just before each of them is removed
+         */
+        template <typename F>
+        void DrainRecoveries(F &&before_remove) {
+            recoveries_.Drain(people, today, [&](size_t index) {
+                MarkDirty(index);
+                before_remove(index);
+                RemoveFromInfected(index);
+            });
+        }
 
         [[nodiscard]] inline int Scale() const { return scale_; }
 
-        std::vector<Person> people;
+        /** @brief An identifier which changes whenever the population's contents are replaced wholesale (by Reset or
+         * CopyFrom), and is unique across all population objects. Caches derived from the population use it to detect
+         * that they must be rebuilt rather than updated.
+         */
+        [[nodiscard]] inline uint64_t BulkRevision() const { return bulk_revision_; }
+
+        People people;
 
-        inline size_t EndOfInfectious() const { return infectious_ptr_; }
-        inline int CurrentlyInfectious() const { return static_cast<int>(infectious_ptr_) * scale_; }
+        /** @brief The indices of the infectious members, in no particular order
+         */
+        inline const std::vector<size_t> &Infectious() const { return infectious_; }
+        inline size_t InfectiousCount() const { return infectious_.size(); }
+        inline bool IsInfectious(size_t index) const {
+            return people.hot.infectious_slot[people.Slot(index)] != People::kNotInfectious;
+        }
+        inline int CurrentlyInfectious() const { return static_cast<int>(infectious_.size()) * scale_; }
         inline int TotalInfections() const { return total_infections * scale_; }
         inline int TotalVaccinated() const { return total_vaccinated * scale_; }
         inline int NeverInfected() const { return never_infected * scale_; }
@@ -53,7 +113,34 @@ namespace sim {
         int vaccinated_infections{};
 
     private:
+        friend class PopulationSnapshot;
+
+        /** @brief Marks the contents as replaced wholesale, for when they were filled in from elsewhere
+         */
+        void Invalidate();
+
+        /** @brief Rebuilds the list of infectious members from the infectious_slot column, for when the column was
+         * filled in from elsewhere
+         */
+        void RebuildInfectious(size_t count);
+
         int scale_{};
-        size_t infectious_ptr_{};
+        std::vector<size_t> infectious_;
+        RecoveryWheel recoveries_;
+        uint64_t bulk_revision_{};
+
+        // Counts every individual modification, so that copies of this population can tell if it has changed
+        uint64_t modifications_{};
+
+        // The population this one was last copied from, and its state at the time
+        const Population* copy_source_{};
+        uint64_t copy_source_revision_{};
+        uint64_t copy_source_modifications_{};
+
+        // Indices modified since the last copy, with one flag per member to keep them unique. When the list
+        // reaches the population size divided by kDirtyLimitDivisor it's abandoned and the next copy is a full one.
+        std::vector<size_t> dirty_;
+        std::vector<uint8_t> dirty_flags_;
+        bool dirty_overflow_{true};
     };
 }
\ No newline at end of file
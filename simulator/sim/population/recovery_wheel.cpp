@@ -0,0 +1,70 @@
+#include "recovery_wheel.hpp"
+#include <algorithm>
+#include <bit>
+
+void sim::RecoveryWheel::Schedule(People &people, size_t index, int day, int today) {
+    if (pending_ == 0) {
+        first_day_ = today + 1;
+    }
+
+    long span = static_cast<long>(day) - first_day_ + 1;
+    if (span > static_cast<long>(buckets_.size())) {
+        Grow(people, span);
+    }
+
+    auto &bucket = Bucket(day);
+    auto slot = people.Touch(index);
+    people.cold.recovery_day[slot] = static_cast<StoredDay>(day);
+    people.cold.recovery_slot[slot] = static_cast<uint32_t>(bucket.size());
+    bucket.push_back(index);
+    pending_++;
+}
+
+void sim::RecoveryWheel::Clear() {
+    for (auto &bucket : buckets_) bucket.clear();
+    pending_ = 0;
+}
+
+void sim::RecoveryWheel::Rebuild(People &people, int today) {
+    Clear();
+    first_day_ = today;
+    int last_day = today;
+    for (size_t slot = people.FirstMemberSlot(); slot < people.SlotCount(); ++slot) {
+        if (people.cold.recovery_day[slot] != kNoRecovery) {
+            first_day_ = std::min<int>(first_day_, people.cold.recovery_day[slot]);
+            last_day = std::max<int>(last_day, people.cold.recovery_day[slot]);
+        }
+    }
+
+    buckets_.clear();
+    buckets_.resize(std::bit_ceil(static_cast<size_t>(std::max(last_day - first_day_ + 1, 16))));
+    // Members go back into the slots they were recorded in, so that the buckets drain in the same order as they
+    // would have in the population the columns came from
+    for (size_t slot = people.FirstMemberSlot(); slot < people.SlotCount(); ++slot) {
+        if (people.cold.recovery_day[slot] != kNoRecovery) {
+            auto &bucket = Bucket(people.cold.recovery_day[slot]);
+            auto position = static_cast<size_t>(people.cold.recovery_slot[slot]);
+            if (bucket.size() <= position) bucket.resize(position + 1);
+            bucket[position] = people.Member(slot);
+            pending_++;
+        }
+    }
+}
+
+void sim::RecoveryWheel::Grow(People &people, long span) {
+    // Collect the scheduled members, then lay them out again on a ring big enough for the new span
+    std::vector<size_t> scheduled;
+    scheduled.reserve(pending_);
+    for (auto &bucket : buckets_) {
+        scheduled.insert(scheduled.end(), bucket.begin(), bucket.end());
+    }
+
+    buckets_.clear();
+    buckets_.resize(std::bit_ceil(static_cast<size_t>(std::max<long>(span, 16))));
+    for (auto index : scheduled) {
+        auto slot = people.Slot(index);
+        auto &bucket = Bucket(people.cold.recovery_day[slot]);
+        people.cold.recovery_slot[slot] = static_cast<uint32_t>(bucket.size());
+        bucket.push_back(index);
+    }
+}
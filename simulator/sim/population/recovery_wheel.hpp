@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "people.hpp"
+
+namespace sim {
+
+    /** @class RecoveryWheel
+     *
+     * @brief A calendar of the days on which carriers stop being infectious
+     *
+     * @summary The day a carrier stops being infectious is known as soon as they're infected, so it's scheduled then
+     * into a ring of per-day buckets which is drained once a day. The ring always spans at least the days from the
+     * first undrained day to the latest scheduled one, and grows if a scheduled day would fall outside of it.
+     *
+     * Buckets hold indices into the population, which are stable since members never move. Each member's scheduled
+     * day and position within its bucket are kept in the recovery_day and recovery_slot columns of People, so that the
+     * buckets can be rebuilt in their original order from the columns alone.
+     */
+    class RecoveryWheel {
+    public:
+        /** @brief Value of the recovery_day column for members who have nothing scheduled
+         */
+        static constexpr int kNoRecovery = kMaxStoredDay;
+
+        /** @brief Schedules the member at `index` to stop being infectious on `day`, which must be after `today`
+         */
+        void Schedule(People &people, size_t index, int day, int today);
+
+        /** @brief Takes every member scheduled on or before `today` off the calendar, calling `recover(index)` for
+         * each
+         */
+        template <typename F>
+        void Drain(People &people, int today, F &&recover) {
+            if (pending_ == 0) {
+                first_day_ = std::max(first_day_, today + 1);
+                return;
+            }
+
+            // Every scheduled day is within one turn of the ring from the first undrained day
+            long days = std::min<long>(static_cast<long>(today) - first_day_ + 1, static_cast<long>(buckets_.size()));
+            for (long d = 0; d < days; ++d) {
+                auto &bucket = Bucket(first_day_ + static_cast<int>(d));
+                for (size_t j = 0; j < bucket.size(); ++j) {
+                    auto index = bucket[j];
+                    people.cold.recovery_day[people.Slot(index)] = kNoRecovery;
+                    recover(index);
+                }
+                pending_ -= bucket.size();
+                bucket.clear();
+            }
+            first_day_ = std::max(first_day_, today + 1);
+        }
+
+        /** @brief Removes every entry, leaving the recovery columns of People to be reset by the caller
+         */
+        void Clear();
+
+        [[nodiscard]] inline size_t Pending() const { return pending_; }
+
+        /** @brief Rebuilds the buckets from the recovery columns of People, for when the columns were filled in from
+         * elsewhere. The
+         * recorded slots are kept, so they must be the dense slots of a wheel that was filled in by Schedule.
+         */
+        void Rebuild(People &people, int today);
+
+    private:
+        std::vector<std::vector<size_t>> buckets_;
+        int first_day_{};
+        size_t pending_{};
+
+        inline std::vector<size_t> &Bucket(int day) {
+            auto size = static_cast<long>(buckets_.size());
+            return buckets_[static_cast<size_t>(((day % size) + size) % size)];
+        }
+
+        void Grow(People &people, long span);
+    };
+
+}
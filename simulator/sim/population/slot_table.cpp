@@ -0,0 +1,59 @@
+#include "slot_table.hpp"
+#include <algorithm>
+#include <bit>
+
+void sim::SlotTable::Insert(size_t index, uint32_t slot) {
+    if (2 * (size_ + 1) > entries_.size()) Grow();
+
+    auto position = Position(index);
+    while (entries_[position].member != kEmpty) {
+        position = (position + 1) & mask_;
+    }
+    entries_[position] = {static_cast<uint32_t>(index), slot};
+    size_++;
+}
+
+void sim::SlotTable::Update(size_t index, uint32_t slot) {
+    entries_[PositionOf(index)].slot = slot;
+}
+
+void sim::SlotTable::Erase(size_t index) {
+    // Every later entry of the probe run moves back into the hole, unless that would put it before the position it
+    // hashes to
+    auto hole = PositionOf(index);
+    for (auto next = (hole + 1) & mask_; entries_[next].member != kEmpty; next = (next + 1) & mask_) {
+        auto home = Position(entries_[next].member);
+        if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+            entries_[hole] = entries_[next];
+            hole = next;
+        }
+    }
+    entries_[hole] = Entry{};
+    size_--;
+}
+
+size_t sim::SlotTable::PositionOf(size_t index) const {
+    auto position = Position(index);
+    while (entries_[position].member != static_cast<uint32_t>(index)) {
+        position = (position + 1) & mask_;
+    }
+    return position;
+}
+
+void sim::SlotTable::Clear() {
+    std::fill(entries_.begin(), entries_.end(), Entry{});
+    size_ = 0;
+}
+
+void sim::SlotTable::Grow() {
+    auto old = std::move(entries_);
+    auto capacity = std::max<size_t>(64, 2 * old.size());
+    entries_.assign(capacity, Entry{});
+    mask_ = capacity - 1;
+    shift_ = 64 - std::countr_zero(capacity);
+    size_ = 0;
+
+    for (const auto &entry : old) {
+        if (entry.member != kEmpty) Insert(entry.member, entry.slot);
+    }
+}
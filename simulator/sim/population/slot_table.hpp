@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+
+    /** @class SlotTable
+     *
+     * @brief An open-addressing hash table from the index of a population member to the slot holding their record
+     *
+     * @summary Used by sparse populations (see People), where only members who have been touched get a record of
+     * their own. Entries are a pair of 32 bit values probed linearly from a Fibonacci hash of the index, and the table
+     * is kept at most half full, so a lookup almost always reads a single cache line. Erasing an entry shifts the rest
+     * of its probe run back, so lookups never have to skip over removed entries.
+     */
+    class SlotTable {
+    public:
+        /** @brief Returned by Find for members without a slot of their own
+         */
+        static constexpr uint32_t kNoSlot = 0;
+
+        /** @brief The slot of the member at `index`, or kNoSlot if they don't have one
+         */
+        [[nodiscard]] inline uint32_t Find(size_t index) const {
+            if (entries_.empty()) return kNoSlot;
+            const auto member = static_cast<uint32_t>(index);
+            for (size_t position = Position(index);; position = (position + 1) & mask_) {
+                const auto &entry = entries_[position];
+                if (entry.member == member) return entry.slot;
+                if (entry.member == kEmpty) return kNoSlot;
+            }
+        }
+
+        /** @brief Starts loading the entry which Find will probe first for the member at `index`
+         */
+        inline void Prefetch(size_t index) const {
+            if (!entries_.empty()) __builtin_prefetch(&entries_[Position(index)]);
+        }
+
+        /** @brief Gives the member at `index`, who must not have a slot yet, the slot `slot`
+         */
+        void Insert(size_t index, uint32_t slot);
+
+        /** @brief Moves the member at `index`, who must have a slot, to the slot `slot`
+         */
+        void Update(size_t index, uint32_t slot);
+
+        /** @brief Takes the slot of the member at `index`, who must have one, away
+         */
+        void Erase(size_t index);
+
+        /** @brief Removes every entry, keeping the table's capacity
+         */
+        void Clear();
+
+        [[nodiscard]] inline size_t size() const { return size_; }
+
+    private:
+        static constexpr uint32_t kEmpty = UINT32_MAX;
+
+        struct Entry {
+            uint32_t member{kEmpty};
+            uint32_t slot{};
+        };
+
+        std::vector<Entry> entries_;
+        size_t mask_{};
+        int shift_{64};
+        size_t size_{};
+
+        [[nodiscard]] inline size_t Position(size_t index) const {
+            return static_cast<size_t>((static_cast<uint64_t>(index) * 0x9e3779b97f4a7c15ull) >> shift_);
+        }
+
+        void Grow();
+
+        [[nodiscard]] size_t PositionOf(size_t index) const;
+    };
+
+}
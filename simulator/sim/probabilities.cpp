@@ -1,2 +1,45 @@
 #include "probabilities.hpp"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+void sim::Philox4x32::Blocks(std::array<uint32_t, 2> key, CounterWords &words) {
+#if defined(__AVX2__)
+    // Each vector holds one word of all the counters. The 64 bit products are taken from the even and the odd 32 bit
+    // elements separately, since _mm256_mul_epu32 only multiplies the even ones.
+    auto load = [&](size_t w) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words[w].data())); };
+    __m256i c0 = load(0), c1 = load(1), c2 = load(2), c3 = load(3);
+    const __m256i mul0 = _mm256_set1_epi32(static_cast<int>(kMul0));
+    const __m256i mul1 = _mm256_set1_epi32(static_cast<int>(kMul1));
+    auto high = [](__m256i x, __m256i mul) {
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, mul), 32);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), mul);
+        return _mm256_blend_epi32(even, odd, 0b10101010);
+    };
+
+    for (int round = 0; round < 10; ++round) {
+        __m256i k0 = _mm256_set1_epi32(static_cast<int>(key[0]));
+        __m256i k1 = _mm256_set1_epi32(static_cast<int>(key[1]));
+        __m256i hi0 = high(c0, mul0), lo0 = _mm256_mullo_epi32(c0, mul0);
+        __m256i hi1 = high(c2, mul1), lo1 = _mm256_mullo_epi32(c2, mul1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+        c1 = lo1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+        c3 = lo0;
+        key[0] += kWeyl0;
+        key[1] += kWeyl1;
+    }
+
+    auto store = [&](size_t w, __m256i x) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(words[w].data()), x); };
+    store(0, c0);
+    store(1, c1);
+    store(2, c2);
+    store(3, c3);
+#else
+    for (size_t i = 0; i < kParallelBlocks; ++i) {
+        auto block = Block(key, {words[0][i], words[1][i], words[2][i], words[3][i]});
+        for (size_t w = 0; w < 4; ++w) words[w][i] = block[w];
+    }
+#endif
+}
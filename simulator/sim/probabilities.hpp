@@ -1,13 +1,122 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <limits>
 #include <random>
 #include <functional>
 #include "data.hpp"
 
 namespace sim {
+
+    /** @class Philox4x32
+     *
+     * @brief Counter-based random bit generator (Philox-4x32-10, Salmon et al. 2011)
+     *
+     * @summary Every output is a pure function of a 64-bit key and a 128-bit counter, so independent streams can be
+     * created for free by choosing distinct counters, and no state needs to be stored or shared between threads. The
+     * first counter word is the position within a stream and the remaining three words identify the stream. Satisfies
+     * UniformRandomBitGenerator so it can drive the std distributions.
+     */
+    class Philox4x32 {
+    public:
+        using result_type = uint64_t;
+
+        Philox4x32(uint64_t key, uint32_t stream0, uint32_t stream1, uint32_t stream2)
+            : key_{static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)}, counter_{0, stream0, stream1, stream2} {}
+
+        /** @summary Creates the same stream from its first block, for when that was already computed (see Blocks)
+         */
+        Philox4x32(uint64_t key, uint32_t stream0, uint32_t stream1, uint32_t stream2,
+                   const std::array<uint32_t, 4> &first_block)
+            : key_{static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)}, counter_{1, stream0, stream1, stream2},
+              block_(first_block), used_(0) {}
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        inline result_type operator()() {
+            if (used_ >= 2) {
+                block_ = Block(key_, counter_);
+                counter_[0]++;
+                used_ = 0;
+            }
+            auto i = 2 * used_++;
+            return (static_cast<uint64_t>(block_[i + 1]) << 32) | block_[i];
+        }
+
+        /** @summary Computes the ten round Philox bijection of a counter under a key
+         */
+        static std::array<uint32_t, 4> Block(std::array<uint32_t, 2> key, std::array<uint32_t, 4> ctr) {
+            for (int round = 0; round < 10; ++round) {
+                uint64_t p0 = static_cast<uint64_t>(kMul0) * ctr[0];
+                uint64_t p1 = static_cast<uint64_t>(kMul1) * ctr[2];
+                ctr = {static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0], static_cast<uint32_t>(p1),
+                       static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1], static_cast<uint32_t>(p0)};
+                key[0] += kWeyl0;
+                key[1] += kWeyl1;
+            }
+            return ctr;
+        }
+
+        static constexpr size_t kParallelBlocks = 8;
+
+        /** @summary Counters given word by word: word w of the i-th counter is `words[w][i]`
+         */
+        using CounterWords = std::array<std::array<uint32_t, kParallelBlocks>, 4>;
+
+        /** @summary Computes Block for kParallelBlocks counters at once, replacing each counter with its block. Uses
+         * AVX2 when the build targets it, which computes all of them in the time of about two.
+         */
+        static void Blocks(std::array<uint32_t, 2> key, CounterWords &words);
+
+    private:
+        static constexpr uint32_t kMul0 = 0xD2511F53;
+        static constexpr uint32_t kMul1 = 0xCD9E8D57;
+        static constexpr uint32_t kWeyl0 = 0x9E3779B9;
+        static constexpr uint32_t kWeyl1 = 0xBB67AE85;
+
+        std::array<uint32_t, 2> key_;
+        std::array<uint32_t, 4> counter_;
+        std::array<uint32_t, 4> block_{};
+        int used_{2};
+    };
+
+    /** @brief Reserved stream identifiers for the serial phases of a simulated day. Carrier streams use the carrier's
+     * index in the population, which is always below these values. The Infection stream is read at positions given by
+     * the index of the newly infected member, see Probabilities::UniformPairAt.
+     */
+    enum class RandomStream : uint32_t {
+        Infection = 0xFFFFFFF0,
+        Vaccination = 0xFFFFFFF1,
+        Initialization = 0xFFFFFFF2,
+        ForceOfInfection = 0xFFFFFFF3,
+    };
+
+    /** @brief Run identifier used for the random streams of population initialization, which happens outside of any
+     * individual run.
+     */
+    constexpr uint32_t kInitializationRun = 0xFFFFFFFF;
+
     class Probabilities {
     public:
+        /**
+         * Creates the random stream identified by a seed, a run number, a simulation day and a stream number within
+         * that day. The same four values always produce the same sequence, regardless of which thread asks for it.
+         */
+        Probabilities(uint64_t seed, uint32_t run, int day, uint32_t stream)
+            : generator_(seed, run, static_cast<uint32_t>(day), stream) {}
+
+        Probabilities(uint64_t seed, uint32_t run, int day, RandomStream stream)
+            : Probabilities(seed, run, day, static_cast<uint32_t>(stream)) {}
+
+        /**
+         * Creates the same stream from its first block, which is Philox4x32::Block of the counter {0, run, day,
+         * stream} under the seed, for when several streams' first blocks were computed at once
+         */
+        Probabilities(uint64_t seed, uint32_t run, int day, uint32_t stream, const std::array<uint32_t, 4> &first_block)
+            : generator_(seed, run, static_cast<uint32_t>(day), stream, first_block) {}
+
         /**
          * Simulates a true or false chance of something happening according to a uniform distribution. If the
          * randomly generated value is less than the probability supplied the function will return true. Thus small
@@ -15,21 +124,54 @@ namespace sim {
          * @param probability a double between 0. and 1. representing the probability of the event occurring
          * @return true if the event "occured", false if not
          */
-        inline bool UniformChance(double probability) { return chance_(generator_) <= probability; }
+        inline bool UniformChance(double probability) { return UniformScalar() <= probability; }
 
         /**
          * Generates a random, uniformly distributed scalar value that will range between 0 and 1
          * @return double between 0 and 1
          */
-        inline double UniformScalar() { return chance_(generator_); }
+        inline double UniformScalar() { return ToScalar(generator_()); }
 
-        inline std::mt19937_64& GetGenerator() { return generator_; }
+        /**
+         * Computes the two uniform scalars at one position of a stream without generating the ones before it. These
+         * are the draws 2 * position and 2 * position + 1 of the same stream created as a Probabilities, and are meant
+         * for draws which are keyed by something like a member's index rather than taken in sequence.
+         */
+        static std::array<double, 2> UniformPairAt(uint64_t seed, uint32_t run, int day, RandomStream stream,
+                                                   uint32_t position) {
+            auto block = Philox4x32::Block({static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+                                           {position, run, static_cast<uint32_t>(day), static_cast<uint32_t>(stream)});
+            return {ToScalar((static_cast<uint64_t>(block[1]) << 32) | block[0]),
+                    ToScalar((static_cast<uint64_t>(block[3]) << 32) | block[2])};
+        }
+
+        /**
+         * Computes UniformPairAt for kParallelBlocks pairs of run and position at once, see Philox4x32::Blocks
+         */
+        static std::array<std::array<double, 2>, Philox4x32::kParallelBlocks>
+        UniformPairsAt(uint64_t seed, const std::array<uint32_t, Philox4x32::kParallelBlocks> &runs, int day,
+                       RandomStream stream, const std::array<uint32_t, Philox4x32::kParallelBlocks> &positions) {
+            Philox4x32::CounterWords words;
+            words[0] = positions;
+            words[1] = runs;
+            words[2].fill(static_cast<uint32_t>(day));
+            words[3].fill(static_cast<uint32_t>(stream));
+            Philox4x32::Blocks({static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}, words);
+
+            std::array<std::array<double, 2>, Philox4x32::kParallelBlocks> pairs;
+            for (size_t i = 0; i < pairs.size(); ++i) {
+                pairs[i] = {ToScalar((static_cast<uint64_t>(words[1][i]) << 32) | words[0][i]),
+                            ToScalar((static_cast<uint64_t>(words[3][i]) << 32) | words[2][i])};
+            }
+            return pairs;
+        }
+
+        inline Philox4x32& GetGenerator() { return generator_; }
 
     private:
-        std::mt19937_64 generator_{std::random_device{}()};
-        std::uniform_real_distribution<double> chance_{0, 1};
+        Philox4x32 generator_;
+
+        static inline double ToScalar(uint64_t bits) { return static_cast<double>(bits >> 11) * 0x1.0p-53; }
     };
 
 }
-
-
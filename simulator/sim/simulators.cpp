@@ -1,7 +1,67 @@
 #include "simulators.hpp"
+#include "snapshot.hpp"
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+sim::DailyTally &sim::DailyTally::operator+=(const DailyTally &other) {
+    infections += other.infections;
+    first_infections += other.first_infections;
+    reinfections += other.reinfections;
+    vaccinated_infections += other.vaccinated_infections;
+    alpha_infections += other.alpha_infections;
+    delta_infections += other.delta_infections;
+    natural_saves += other.natural_saves;
+    vaccine_saves += other.vaccine_saves;
+    return *this;
+}
+
+void sim::DailyTally::AddTo(Population &population) const {
+    population.total_infections += infections;
+    population.never_infected -= first_infections;
+    population.reinfections += reinfections;
+    population.vaccinated_infections += vaccinated_infections;
+    population.total_alpha_infections += alpha_infections;
+    population.total_delta_infections += delta_infections;
+    population.natural_saves += natural_saves;
+    population.vaccine_saves += vaccine_saves;
+}
+
+sim::Simulator::Simulator(std::shared_ptr<const SimulationPlan> plan, std::shared_ptr<ThreadPool> pool)
+    : plan_(std::move(plan)), options_(plan_->options), seed_(plan_->seed), pool_(std::move(pool)) {
+    if (!pool_) {
+        pool_ = std::make_shared<ThreadPool>(static_cast<size_t>(std::max(options_.threads, 0)));
+    }
 
-sim::Simulator::Simulator(const data::ProgramOptions &options, std::shared_ptr<const VariantDictionary> variants)
-    : options_(options), variants_(variants) {}
+    if (options_.serial_threshold >= 0) {
+        serial_threshold_ = static_cast<size_t>(options_.serial_threshold);
+    } else if (pool_->Size() > 1) {
+        // Measured once per pool, which every simulator sharing it then reuses
+        dispatch_ns_ = pool_->DispatchNanoseconds();
+    }
+}
+
+void sim::Simulator::RecordCarrierCost(size_t carriers, double nanoseconds, bool serial) {
+    if (carriers == 0) return;
+
+    // On parallel days the time is shared by as many threads as there were chunks of carriers to go around, less
+    // what it cost to hand them out
+    double per_carrier = nanoseconds / static_cast<double>(carriers);
+    if (!serial) {
+        auto threads = static_cast<double>(pool_->Size());
+        auto grain = std::max(kMinCarrierChunk, carriers / (8 * pool_->Size()));
+        auto chunks = static_cast<double>((carriers + grain - 1) / grain);
+        per_carrier = std::max(0.0, nanoseconds - dispatch_ns_) * std::min(threads, chunks) /
+                      static_cast<double>(carriers);
+    }
+    carrier_ns_ = carrier_ns_ > 0 ? 0.75 * carrier_ns_ + 0.25 * per_carrier : per_carrier;
+
+    // Splitting n carriers over T threads saves n * c * (1 - 1/T) and costs the dispatch
+    auto threads = static_cast<double>(pool_->Size());
+    auto saving = carrier_ns_ * (1.0 - 1.0 / threads);
+    serial_threshold_ = saving > 0 ? static_cast<size_t>(std::min(dispatch_ns_ / saving, 1.0e9))
+                                   : std::numeric_limits<size_t>::max();
+}
 
 sim::DailySummary sim::Simulator::GetDailySummary(const sim::Population &population, bool expensive) const {
     sim::DailySummary step{};
@@ -21,10 +81,11 @@ sim::DailySummary sim::Simulator::GetDailySummary(const sim::Population &populat
     // Expensive summary statistics
     if (expensive) {
         step.population_infectiousness = 0;
-        for (int i = 0; i < population.EndOfInfectious(); i++) {
-            const auto &person = population.people[i];
-            step.population_infectiousness +=
-                variants_->at(person.variant)->GetInfectivity(population.today - person.symptom_onset);
+        for (auto i : population.Infectious()) {
+            auto slot = population.people.Slot(i);
+            const auto &info = plan_->VariantInfo(population.people.hot.variant[slot]);
+            step.population_infectiousness += info.GetInfectivity(population.today -
+                                                                  population.people.hot.symptom_onset[slot]);
         }
         step.population_infectiousness *= population.Scale();
     }
@@ -33,58 +94,105 @@ sim::DailySummary sim::Simulator::GetDailySummary(const sim::Population &populat
 }
 
 void sim::Simulator::InfectPerson(sim::Population &population, size_t person_index,
-                                  const VariantProbabilities &variant) {
+                                  const VariantProbabilities &variant, Probabilities &prob) {
+    auto incubation = variant.GetRandomIncubation(prob);
+    auto natural_immunity_scalar = (float)prob.UniformScalar();
+    InfectPerson(population, person_index, variant, incubation, natural_immunity_scalar);
+}
+
+void sim::Simulator::InfectPerson(sim::Population &population, size_t person_index,
+                                  const VariantProbabilities &variant, int incubation, float natural_immunity_scalar) {
+    DailyTally tally;
+    WriteInfection(population, person_index, variant, incubation, natural_immunity_scalar, tally);
+    tally.AddTo(population);
+    RegisterInfection(population, person_index, variant);
+}
 
-    auto &person = population.people[person_index];
+void sim::Simulator::WriteInfection(sim::Population &population, size_t person_index,
+                                    const VariantProbabilities &variant, int incubation, float natural_immunity_scalar,
+                                    DailyTally &tally) const {
+    auto person = population.people[person_index];
     if (person.variant == Variant::None) {
-        population.never_infected--;
+        tally.first_infections++;
     } else {
-        population.reinfections++;
+        tally.reinfections++;
     }
 
     if (person.is_vaccinated) {
-        population.vaccinated_infections++;
+        tally.vaccinated_infections++;
     }
 
     person.variant = variant.GetVariant();
     person.infected_day = population.today;
-    person.symptom_onset = population.today + variant.GetRandomIncubation(prob_.GetGenerator());
-    person.natural_immunity_scalar = (float)prob_.UniformScalar();
-    population.AddToInfected(person_index);
+    person.symptom_onset = population.today + incubation;
+    person.natural_immunity_scalar = natural_immunity_scalar;
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        const auto &info = *plan_->variants[v];
+        if (info.HasNaturalWindows()) {
+            population.people.hot.natural_window[v][population.people.Slot(person_index)] =
+                info.NaturalImmunityWindow(person.natural_immunity_scalar, population.today);
+        }
+    }
+    tally.infections++;
+
+    if (variant.GetVariant() == Variant::Delta)
+        tally.delta_infections++;
+    if (variant.GetVariant() == Variant::Alpha)
+        tally.alpha_infections++;
+}
+
+void sim::Simulator::RegisterInfection(sim::Population &population, size_t person_index,
+                                       const VariantProbabilities &variant) {
+    population.MarkDirty(person_index);
+    if (variant.RecoveryOffset() != VariantProbabilities::kNoRecovery) {
+        population.ScheduleRecovery(person_index,
+                                    population.people.hot.symptom_onset[population.people.Slot(person_index)] +
+                                        variant.RecoveryOffset());
+    }
 
-    population.total_infections++;
+    immunity_bits_.Touch(population, person_index);
+    population.AddToInfected(person_index);
+}
 
-    if (person.variant == Variant::Delta)
-        population.total_delta_infections++;
-    if (person.variant == Variant::Alpha)
-        population.total_alpha_infections++;
+void sim::Simulator::ApplyVaccines(sim::Population &population) {
+    ApplyVaccines(population, run_);
 }
 
-void sim::Simulator::ApplyVaccines(sim::Population &population,
-                                   const std::unordered_map<int, data::VaccineHistory> &vaccines) {
+void sim::Simulator::ApplyVaccines(sim::Population &population, uint32_t run) {
     // The issue that we have with the vaccine history is that it's taking into account "completed" vaccinations, which
     // means the patient has received the second shot.  Because we can't track vaccinations individually, the
     // approximation chosen here is to look at completed vaccinations 21 days in the future and apply those vaccinations
     // today. The immunity will begin to ramp up according to the efficacy curves.
 
-    auto shifted = population.today + 21;
-    auto vax = vaccines.find(shifted);
-    if (vax == vaccines.end())
+    auto total_completed_vax = plan_->TotalCompletedVax(population.today + 21);
+    if (total_completed_vax == SimulationPlan::kNoRecord)
         return;
 
-    const auto &today_data = vax->second;
-    int to_be_vaxxed = today_data.total_completed_vax / population.Scale();
-    auto search_position = population.EndOfInfectious();
+    Probabilities prob(seed_, run, population.today, RandomStream::Vaccination);
+    int to_be_vaxxed = total_completed_vax / population.Scale();
+    size_t search_position = 0;
 
         // Scan forward
     while (to_be_vaxxed > population.total_vaccinated) {
-        auto& person = population.people[search_position];
-        if (!person.is_vaccinated) {
-            if (!person.IsInfected() || (population.today - person.infected_day > 30)) {
+        // Read before writing so that sparse storage doesn't give everyone scanned past a record of their own
+        const auto &people = population.people;
+        const auto candidate = people[search_position];
+        if (!candidate.is_vaccinated && !population.IsInfectious(search_position)) {
+            if (!candidate.IsInfected() || (population.today - candidate.infected_day > 30)) {
+                auto person = population.people[search_position];
                 person.is_vaccinated = true;
                 person.vaccination_day = population.today;
-                person.vaccine_immunity_scalar = (float)prob_.UniformScalar();
+                person.vaccine_immunity_scalar = (float)prob.UniformScalar();
+                for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+                    const auto &info = *plan_->variants[v];
+                    if (info.HasVaxWindows()) {
+                        population.people.hot.vaccine_window[v][population.people.Slot(search_position)] =
+                            info.VaxImmunityWindow(person.vaccine_immunity_scalar, population.today);
+                    }
+                }
                 population.total_vaccinated++;
+                population.MarkDirty(search_position);
+                immunity_bits_.Touch(population, search_position);
             }
         }
 
@@ -95,213 +203,378 @@ void sim::Simulator::ApplyVaccines(sim::Population &population,
     }
 }
 
-std::vector<sim::DailySummary> sim::Simulator::InitializePopulation(
-    sim::Population &population, const std::unordered_map<int, data::InfectedHistory> &history,
-    const std::unordered_map<int, data::VaccineHistory> &vaccines,
-    const std::vector<data::VariantRecord> &variant_history, std::optional<date::sys_days> up_to) {
+std::vector<sim::DailySummary> sim::Simulator::InitializePopulation(sim::Population &population,
+                                                                   std::optional<date::sys_days> up_to) {
 
-    population.Reset();
-    std::vector<DailySummary> summaries;
+    int max_day = plan_->history_last_day;
+    if (up_to.has_value()) {
+        max_day = data::ToReferenceDate(up_to.value());
+    }
 
-    // Get the min and max days of interest
-    population.today = std::numeric_limits<int>::max();
-    int max_day = std::numeric_limits<int>::min();
-    for (const auto &[day, _] : history) {
-        population.today = std::min(population.today, day);
-        max_day = std::max(max_day, day);
+    if (options_.cache_dir.empty()) {
+        population.Reset();
+        population.today = plan_->history_first_day;
+        return ReplayHistory(population, max_day);
     }
 
-    if (up_to.has_value()) {
-        max_day = data::ToReferenceDate(up_to.value());
+    std::vector<DailySummary> summaries;
+    auto key = PopulationSnapshot::Key(*plan_, max_day);
+    auto file_name = PopulationSnapshot::Path(options_.cache_dir, key);
+    if (PopulationSnapshot::Load(file_name, key, population, summaries)) {
+        return summaries;
     }
 
-    while (population.today < max_day) {
-        auto h = history.find(population.today);
-        if (h == history.end())
+    population.Reset();
+    population.today = plan_->history_first_day;
+    summaries = ReplayHistory(population, max_day);
+    PopulationSnapshot::Save(file_name, key, population, summaries);
+    return summaries;
+}
+
+std::vector<sim::DailySummary> sim::Simulator::AdvancePopulation(sim::Population &population,
+                                                                date::sys_days up_to) {
+    return ReplayHistory(population, data::ToReferenceDate(up_to));
+}
+
+std::vector<sim::DailySummary> sim::Simulator::ReplayHistory(sim::Population &population, int max_day) {
+    // Every day draws from its own random stream and only depends on the state left by the days before it, so
+    // replaying in several steps gives the same population as replaying in one
+    std::vector<DailySummary> summaries;
+
+    for (; population.today < max_day; population.today++) {
+        if (!plan_->HasInfections(population.today))
             continue;
 
-        auto variant_fractions = data::GetVariantFractions(population.today, variant_history);
+        const auto &variant_fractions = plan_->VariantFractionsOn(population.today);
+        Probabilities prob(seed_, kInitializationRun, population.today, RandomStream::Initialization);
 
         // The number of infections we need
-        int new_infections = h->second.total_infections - population.TotalInfections();
+        int new_infections = plan_->TotalInfections(population.today) - population.TotalInfections();
         double scaled_new_infections = std::round(static_cast<double>(new_infections) / population.Scale());
 
-        for (const auto &[variant, fraction] : variant_fractions) {
-            auto to_add = static_cast<int>(std::round(fraction * scaled_new_infections));
-            const auto& variant_info = variants_->at(variant);
+        for (size_t v = 0; v < kVariantCount; ++v) {
+            auto to_add = static_cast<int>(std::round(variant_fractions[v] * scaled_new_infections));
+            if (to_add <= 0)
+                continue;
+            const auto *variant_info = plan_->variants[v].get();
 
             while (to_add > 0) {
-                // Pick someone at random
-                std::uniform_int_distribution<size_t> selector(population.EndOfInfectious(), population.people.size());
-                auto contact_index = selector(prob_.GetGenerator());
-                const auto &contact = population.people[contact_index];
+                // Pick someone at random who isn't already infectious
+                std::uniform_int_distribution<size_t> selector(0, population.people.size() - 1);
+                auto contact_index = selector(prob.GetGenerator());
+                if (population.IsInfectious(contact_index))
+                    continue;
 
                 // Check for natural immunity
-                if (variant_info->IsPersonNatImmune(contact, population.today))
+                if (variant_info->IsPersonNatImmune(population.people, contact_index, population.today))
                     continue;
 
                 // Check for vaccine immunity
-                if (variant_info->IsPersonVaxImmune(contact, population.today))
+                if (variant_info->IsPersonVaxImmune(population.people, contact_index, population.today))
                     continue;
 
                 // Failed immunity save, person gets infected
-                InfectPerson(population, contact_index, *variant_info);
+                InfectPerson(population, contact_index, *variant_info, prob);
                 to_add--;
             }
         }
 
-        ApplyVaccines(population, vaccines);
+        ApplyVaccines(population, kInitializationRun);
 
         // Remove anyone who's no longer infectious
-        for (int i = static_cast<int>(population.EndOfInfectious()) - 1; i >= 0; --i) {
-            const auto &person = population.people[i];
-            int days_from_symptoms = population.today - person.symptom_onset;
-            if (days_from_symptoms > 0 && variants_->at(person.variant)->GetInfectivity(days_from_symptoms) <= 0) {
-                population.RemoveFromInfected(i);
-            }
-        }
+        RemoveRecovered(population);
 
         // If the options are set to export the full history, we do it here
         if (options_.full_history) {
             summaries.push_back(GetDailySummary(population, options_.expensive_stats));
         }
-
-        population.today++;
     }
 
     return summaries;
 }
 
 sim::DailySummary sim::Simulator::SimulateDay(sim::Population &population) {
-    std::vector<size_t> no_longer_infectious;
-    std::vector<std::tuple<size_t, Variant>> to_infect;
+    const bool use_bitsets = options_.immunity_bitsets;
+    if (use_bitsets) {
+        immunity_bits_.Update(population, *plan_);
+    }
+    claims_.Resize(population.people.size());
+    tallies_.Reset(*pool_);
+
+    // Days with few carriers run on this thread alone, and the steps which could be split are timed to keep the
+    // threshold up to date
+    using Clock = std::chrono::steady_clock;
+    const size_t carriers = population.InfectiousCount();
+    const bool serial = pool_->Size() == 1 || carriers < serial_threshold_;
+    (serial ? schedule_.serial_days : schedule_.parallel_days)++;
+    Clock::duration split_time{};
+
+    // First, find the new infections, which are claimed now and applied in a later step
+#ifdef PERF_MEASURE
+    loop_timer.Start();
+#endif
 
-    auto normalized_contact = contact_probability_ / static_cast<int>(population.people.size());
+    if (options_.engine == data::InfectionEngine::Aggregate) {
+        SampleForceOfInfection(population, use_bitsets);
+    } else {
+        auto start = Clock::now();
+        TraceCarrierContacts(population, use_bitsets, serial);
+        split_time += Clock::now() - start;
+    }
 
-    // First, calculate the new infections, which will be applied in a later step
 #ifdef PERF_MEASURE
-    loop_timer.Start();
+    loop_timer.Stop();
+    remove_timer.Start();
 #endif
 
-#pragma omp parallel default(none) shared(population, no_longer_infectious, to_infect) firstprivate(normalized_contact)
-{
+    // Remove people from the cache who are no long infectious, which were scheduled when they were infected
+    RemoveRecovered(population);
+
 #ifdef PERF_MEASURE
-    PerfTimer t_alloc;
-    t_alloc.Start();
+    remove_timer.Stop();
+    infect_timer.Start();
 #endif
-    Probabilities prob;
-    std::vector<size_t> local_no_longer_infectious;
-    std::vector<std::tuple<size_t, Variant>> local_to_infect;
-    std::binomial_distribution<int> self_contact_dist(static_cast<int>(population.people.size()), normalized_contact);
-    std::uniform_int_distribution<int> selector_dist(0, static_cast<int>(population.people.size()));
+
+    auto start = Clock::now();
+    ApplyClaims(population, serial);
+    split_time += Clock::now() - start;
+    tallies_.Sum().AddTo(population);
+
+    if (options_.serial_threshold < 0 && pool_->Size() > 1) {
+        RecordCarrierCost(carriers, std::chrono::duration<double, std::nano>(split_time).count(), serial);
+    }
+
 #ifdef PERF_MEASURE
-    t_alloc.Stop();
+    infect_timer.Stop();
 #endif
 
-#pragma omp for
-    for (int carrier_index = 0; carrier_index < population.EndOfInfectious(); carrier_index++) {
-        const auto &carrier = population.people[carrier_index];
+    auto result = GetDailySummary(population, options_.expensive_stats);
 
-        // How infectious are they today
-        const auto &variant_info = variants_->at(carrier.variant);
-        auto infection_p = variant_info->GetInfectivity(population.today - carrier.symptom_onset);
+    population.today++;
+    return result;
+}
 
-        // Check if this guy has passed the point of being infectious
-        if (infection_p <= 0 && population.today > carrier.symptom_onset) {
-            local_no_longer_infectious.push_back(carrier_index);
-            continue;
+void sim::Simulator::ApplyClaims(sim::Population &population, bool serial) {
+    const size_t word_count = claims_.WordCount();
+    const size_t chunk_count = (word_count + kClaimWordsPerChunk - 1) / kClaimWordsPerChunk;
+    if (scratch_.size() < chunk_count) scratch_.resize(chunk_count);
+
+    // Sparse storage gives new infections a slot of their own, which can move every column. The day's claimed members
+    // get their slots up front, so that the infections can still be written from several threads.
+    if (population.people.IsSparse()) {
+        for (size_t word = 0; word < word_count; ++word) {
+            for (auto bits = claims_.Claimed(word); bits; bits &= bits - 1) {
+                population.people.Touch(word * 64 + static_cast<size_t>(std::countr_zero(bits)));
+            }
         }
+    }
 
-        // Randomly determine how many contacts this person had during the past day, we can
-        // move onto the next person if we don't have any
-        auto contact_count = self_contact_dist(prob.GetGenerator());
-        if (!contact_count)
-            continue;
+    pool_->ParallelFor(0, chunk_count, DayGrain(serial, chunk_count, 1), [&](size_t first, size_t last) {
+        auto &tally = tallies_.Local();
+        for (size_t chunk = first; chunk < last; ++chunk) {
+            auto &scratch = scratch_[chunk];
+            scratch.members.clear();
+            scratch.variants.clear();
+
+            const size_t end_word = std::min(word_count, (chunk + 1) * kClaimWordsPerChunk);
+            for (size_t word = chunk * kClaimWordsPerChunk; word < end_word; ++word) {
+                claims_.Collect(word, [&](size_t index, size_t v) {
+                    scratch.members.push_back(index);
+                    scratch.variants.push_back(v);
+                });
+            }
 
-        // Now we'll iterate through that number of contacts, picking someone from the population at random
-        // to act as the person who had contact with this carrier.
-        for (int i = 0; i < contact_count; ++i) {
-            // Randomly pick a member of the population
-            int contact_index = selector_dist(prob.GetGenerator());
-            const auto &contact = population.people[contact_index];
-            if (contact_index < population.EndOfInfectious()) continue;
+            // The random parts of each infection are taken from the member's own position in the infection stream,
+            // so they don't depend on which thread handles it. The incubation periods of each variant's infections
+            // are then sampled as a batch.
+            const auto &members = scratch.members;
+            const size_t count = members.size();
+            scratch.uniforms.resize(count);
+            scratch.scalars.resize(count);
+            scratch.incubations.resize(count);
+            for (size_t k = 0; k < count; ++k) {
+                auto pair = Probabilities::UniformPairAt(seed_, run_, population.today, RandomStream::Infection,
+                                                         static_cast<uint32_t>(members[k]));
+                scratch.uniforms[k] = pair[0];
+                scratch.scalars[k] = static_cast<float>(pair[1]);
+            }
 
-            // If the carrier's roll for infection doesn't succeed, continue
-            if (!prob.UniformChance(infection_p))
-                continue;
+            for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+                scratch.positions.clear();
+                scratch.variant_uniforms.clear();
+                for (size_t k = 0; k < count; ++k) {
+                    if (scratch.variants[k] == v) {
+                        scratch.positions.push_back(k);
+                        scratch.variant_uniforms.push_back(scratch.uniforms[k]);
+                    }
+                }
+
+                scratch.variant_incubations.resize(scratch.positions.size());
+                plan_->variants[v]->SampleIncubations(scratch.variant_uniforms.data(),
+                                                      scratch.variant_incubations.data(), scratch.positions.size());
+                for (size_t j = 0; j < scratch.positions.size(); ++j) {
+                    scratch.incubations[scratch.positions[j]] = scratch.variant_incubations[j];
+                }
+            }
 
-            // At this point the carrier has successfully rolled to infect the contact. Now we will see if the contact
-            // has an immunity which can prevent the infection.
-            // Check if they have natural immunity
-            if (variant_info->IsPersonNatImmune(contact, population.today)) {
-                #pragma omp atomic
-                population.natural_saves++;
-                continue;
+            for (size_t k = 0; k < count; ++k) {
+                WriteInfection(population, members[k], *plan_->variants[scratch.variants[k]], scratch.incubations[k],
+                               scratch.scalars[k], tally);
             }
+        }
+    });
+
+    // What's left is O(1) per infection but touches structures shared by every member. Going through the chunks in
+    // order registers the infections in order of index.
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        for (auto index : scratch_[chunk].members) {
+            RegisterInfection(population, index,
+                              plan_->VariantInfo(population.people.hot.variant[population.people.Slot(index)]));
+        }
+    }
+}
+
+void sim::Simulator::TraceCarrierContacts(sim::Population &population, bool use_bitsets, bool serial) {
+    transmission_tables_.Prepare(*plan_, contact_probability_, population.people.size());
+
+    const auto batch = static_cast<size_t>(std::clamp(options_.prefetch_batch, 1, static_cast<int>(kMaxPrefetchBatch)));
+    const auto &carriers = population.Infectious();
+
+    // The carriers are split in halves down to a few chunks per thread, and further only where threads run out of
+    // work, since the number of transmissions per carrier varies a lot
+    const size_t grain = std::max(kMinCarrierChunk, carriers.size() / (8 * pool_->Size()));
+
+    pool_->ParallelFor(0, carriers.size(), DayGrain(serial, carriers.size(), grain), [&](size_t first, size_t last) {
+        std::uniform_int_distribution<int> selector_dist(0, static_cast<int>(population.people.size()) - 1);
+        auto &tally = tallies_.Local();
+        std::array<PendingContact, kMaxPrefetchBatch> pending;
+        size_t pending_count = 0;
+
+        for (size_t k = first; k < last; k++) {
+            const size_t carrier_index = carriers[k];
+            const size_t carrier_slot = population.people.Slot(carrier_index);
+            const Variant carrier_variant = population.people.hot.variant[carrier_slot];
+            const int carrier_onset = population.people.hot.symptom_onset[carrier_slot];
+
+            // How infectious are they today
+            const auto variant_index = VariantIndex(carrier_variant);
+            const auto *variant_info = plan_->variants[variant_index].get();
+            const auto &infectivity = variant_info->Properties().infectivity;
+            const auto curve_index = infectivity.Index(population.today - carrier_onset);
+            auto infection_p = infectivity.values[curve_index];
+
+            // Carriers with no infectivity today can't infect anyone. Those who have passed the point of being
+            // infectious are taken out of the infectious set after this loop.
+            if (infection_p <= 0)
+                continue;
+
+            // Every carrier draws from its own random stream, so the outcome doesn't depend on which thread handles
+            // them
+            Probabilities prob(seed_, run_, population.today, static_cast<uint32_t>(carrier_index));
 
-            // Check if they have vaccine immunity
-            if (variant_info->IsPersonVaxImmune(contact, population.today)) {
-                #pragma omp atomic
-                population.vaccine_saves++;
+            // The carrier's contacts during the past day are Binomial(N, c/N), and each one transmits with
+            // probability infection_p. Thinning the contacts by that probability makes the successful transmissions
+            // Binomial(N, infection_p * c/N), so those are drawn directly from the precomputed table and only they
+            // pick someone from the population. We can move onto the next person if there aren't any.
+            auto transmission_count = transmission_tables_.At(variant_index, curve_index).Sample(prob.UniformScalar());
+            if (!transmission_count)
                 continue;
+
+            // Randomly pick the members of the population who were reached. They're screened in batches, which may
+            // span several carriers, so that the reads of their records overlap instead of stalling one after the
+            // other.
+            for (int i = 0; i < transmission_count; ++i) {
+                pending[pending_count++] = {static_cast<size_t>(selector_dist(prob.GetGenerator())), variant_index};
+                if (pending_count == batch) {
+                    ScreenContacts(population, use_bitsets, pending.data(), pending_count, tally);
+                    pending_count = 0;
+                }
             }
+        }
 
-            local_to_infect.emplace_back(contact_index, carrier.variant);
+        ScreenContacts(population, use_bitsets, pending.data(), pending_count, tally);
+    });
+}
+
+void sim::Simulator::ScreenContacts(const sim::Population &population, bool use_bitsets,
+                                    const PendingContact *contacts, size_t count, DailyTally &tally) {
+    for (size_t k = 0; k < count; ++k) {
+        const auto &[contact_index, variant_index] = contacts[k];
+        population.people.PrefetchSlot(contact_index);
+        if (use_bitsets) {
+            immunity_bits_.Prefetch(variant_index, contact_index);
+        } else {
+            plan_->variants[variant_index]->PrefetchPerson(population.people, contact_index);
         }
     }
 
-    #pragma omp critical (sim_day_merge)
-    {
-        no_longer_infectious.insert(no_longer_infectious.end(), local_no_longer_infectious.begin(), local_no_longer_infectious.end());
-        to_infect.insert(to_infect.end(), local_to_infect.begin(), local_to_infect.end());
-#ifdef PERF_MEASURE
-        alloc += t_alloc.Elapsed();
-#endif
+    for (size_t k = 0; k < count; ++k) {
+        const auto &[contact_index, variant_index] = contacts[k];
+        if (population.IsInfectious(contact_index)) continue;
+
+        // At this point the carrier has successfully rolled to infect the contact. Now we will see if the contact
+        // has an immunity which can prevent the infection.
+        // Check if they have natural immunity
+        const auto *variant_info = plan_->variants[variant_index].get();
+        if (use_bitsets ? immunity_bits_.IsNatImmune(variant_index, contact_index)
+                        : variant_info->IsPersonNatImmune(population.people, contact_index, population.today)) {
+            tally.natural_saves++;
+            continue;
+        }
+
+        // Check if they have vaccine immunity
+        if (use_bitsets ? immunity_bits_.IsVaxImmune(variant_index, contact_index)
+                        : variant_info->IsPersonVaxImmune(population.people, contact_index, population.today)) {
+            tally.vaccine_saves++;
+            continue;
+        }
+
+        claims_.Claim(variant_index, contact_index);
     }
 }
 
-#ifdef PERF_MEASURE
-    loop_timer.Stop();
-    remove_timer.Start();
-#endif
-
-    // Remove people from the cache who are no long infectious. This has to be done from largest to smallest, in order
-    // to prevent the mechanism from moving a person at the end of the list to somewhere else
-    std::sort(no_longer_infectious.begin(), no_longer_infectious.end(), std::greater<>());
-    for (auto index : no_longer_infectious) {
-        population.RemoveFromInfected(index);
+void sim::Simulator::SampleForceOfInfection(sim::Population &population, bool use_bitsets) {
+    // Under homogeneous mixing every carrier has Binomial(N, c/N) contacts with uniformly chosen members, each of
+    // which transmits with the carrier's infectivity. Thinning those contacts by infectivity and pooling the carriers
+    // of a variant leaves a number of transmissions which is very nearly Poisson with mean c * sum(infectivity),
+    // each to a uniformly chosen member. So only the infectivity of the carriers is summed, and the work per
+    // transmission is the same immunity screening as in the per-carrier engine.
+    std::array<double, kVariantCount> force{};
+    for (auto carrier_index : population.Infectious()) {
+        const auto carrier_slot = population.people.Slot(carrier_index);
+        const int carrier_onset = population.people.hot.symptom_onset[carrier_slot];
+        const auto variant_index = VariantIndex(population.people.hot.variant[carrier_slot]);
+        force[variant_index] += plan_->variants[variant_index]->GetInfectivity(population.today - carrier_onset);
     }
-//    for (int i = static_cast<int>(population.EndOfInfectious()) - 1; i >= 0; --i) {
-//        const auto &person = population.people[i];
-//        int days_from_symptoms = population.today - person.symptom_onset;
-//        if (days_from_symptoms > 0 && variants_->at(person.variant)->GetInfectivity(days_from_symptoms) <= 0) {
-//            population.RemoveFromInfected(i);
-//        }
-//    }
 
-#ifdef PERF_MEASURE
-    remove_timer.Stop();
-    infect_timer.Start();
-#endif
+    Probabilities prob(seed_, run_, population.today, RandomStream::ForceOfInfection);
+    auto &tally = tallies_.Local();
+    const auto batch = static_cast<size_t>(std::clamp(options_.prefetch_batch, 1, static_cast<int>(kMaxPrefetchBatch)));
+    std::array<PendingContact, kMaxPrefetchBatch> pending;
+    size_t pending_count = 0;
+
+    std::uniform_int_distribution<size_t> selector_dist(0, population.people.size() - 1);
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        if (force[v] <= 0)
+            continue;
 
-    // Add the newly infected. This has to be done from smallest to largest, to prevent the infectious_ptr_ from
-    // advancing beyond the people to be infected at the front of the list, sending them off to elsewhere
-    std::sort(to_infect.begin(), to_infect.end());
-    size_t last_infected = population.people.size() + 1;
-    for (const auto &[selected, variant] : to_infect) {
-        // This mechanism prevents the same person from being infected multiple times, which won't work because someone
-        // else is in that index after the swap
-        if (selected == last_infected) continue;
-
-        InfectPerson(population, selected, *variants_->at(variant));
-        last_infected = selected;
+        std::poisson_distribution<long> transmission_dist(contact_probability_ * force[v]);
+        auto transmissions = transmission_dist(prob.GetGenerator());
+
+        // Transmissions which land on someone who is already a carrier have no effect, which is left to the screening
+        for (long i = 0; i < transmissions; ++i) {
+            pending[pending_count++] = {selector_dist(prob.GetGenerator()), v};
+            if (pending_count == batch) {
+                ScreenContacts(population, use_bitsets, pending.data(), pending_count, tally);
+                pending_count = 0;
+            }
+        }
     }
-#ifdef PERF_MEASURE
-    infect_timer.Stop();
-#endif
 
-    auto result = GetDailySummary(population, options_.expensive_stats);
+    ScreenContacts(population, use_bitsets, pending.data(), pending_count, tally);
+}
 
-    population.today++;
-    return result;
+void sim::Simulator::RemoveRecovered(sim::Population &population) {
+    // Leaving the infectious set doesn't change anyone's immunity, so there's nothing to report to the bitsets
+    population.DrainRecoveries([](size_t) {});
 }
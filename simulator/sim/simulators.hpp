@@ -1,9 +1,15 @@
 #pragma once
 #include "data.hpp"
+#include "immunity_bitsets.hpp"
+#include "infection_claims.hpp"
+#include "per_thread.hpp"
+#include "plan.hpp"
 #include "timer.hpp"
 #include "population/person.hpp"
 #include "population/population.hpp"
 #include "probabilities.hpp"
+#include "thread_pool.hpp"
+#include "transmission_tables.hpp"
 #include "variant_probabilities.hpp"
 #include <limits>
 #include <memory>
@@ -15,39 +21,202 @@
 
 namespace sim {
 
+/** @brief The changes made to a population's counters during a day by the steps that run in parallel. Each thread
+ * counts into its own tally, and the tallies are added to the population once the day's work is done.
+ */
+struct DailyTally {
+    int infections{};
+    int first_infections{};
+    int reinfections{};
+    int vaccinated_infections{};
+    int alpha_infections{};
+    int delta_infections{};
+    int natural_saves{};
+    int vaccine_saves{};
+
+    DailyTally &operator+=(const DailyTally &other);
+    void AddTo(Population &population) const;
+};
+
+/** @brief Buffers used while applying one chunk of a day's infections. They're kept by the simulator between days
+ * so that, once they've grown to the size of the epidemic, simulating a day doesn't allocate.
+ */
+struct InfectionScratch {
+    std::vector<size_t> members;
+    std::vector<size_t> variants;
+    std::vector<double> uniforms;
+    std::vector<float> scalars;
+    std::vector<int> incubations;
+    std::vector<size_t> positions;
+    std::vector<double> variant_uniforms;
+    std::vector<int> variant_incubations;
+};
+
+/** @brief How many of the days simulated so far ran on the calling thread alone, and how many were split over the
+ * thread pool
+ */
+struct ScheduleStats {
+    long serial_days{};
+    long parallel_days{};
+};
+
+/** @class Simulator
+ *
+ * @brief Advances populations through time according to a simulation plan
+ *
+ * @summary A simulator holds only the state of the run it's currently driving (run number, contact probability and
+ * caches of the population it last simulated), while the plan is shared and read-only. Copies are cheap, so replicas
+ * that run concurrently should each use their own copy. Copies also share the thread pool the simulation steps run
+ * on, which is created with the number of threads in the options unless one is given.
+ */
 class Simulator {
   public:
-    Simulator(const data::ProgramOptions &options, std::shared_ptr<const VariantDictionary> variants);
+    explicit Simulator(std::shared_ptr<const SimulationPlan> plan, std::shared_ptr<ThreadPool> pool = {});
+
+    /** @brief The thread pool the simulation steps run on, which other work may share
+     */
+    [[nodiscard]] inline ThreadPool &Pool() const { return *pool_; }
 
     [[nodiscard]] DailySummary GetDailySummary(const sim::Population &population, bool expensive) const;
 
+    /** @brief Resets the population and brings it forward through the infection history, stopping before `up_to` or
+     * at the end of the history. When the options name a cache directory the result is read from a snapshot written
+     * by an earlier identical initialization if there is one, and saved there otherwise.
+     */
     std::vector<DailySummary> InitializePopulation(sim::Population &population,
-                                                   const std::unordered_map<int, data::InfectedHistory> &history,
-                                                   const std::unordered_map<int, data::VaccineHistory> &vaccines,
-                                                   const std::vector<data::VariantRecord> &variant_history,
                                                    std::optional<date::sys_days> up_to = {});
 
-    void InfectPerson(sim::Population &population, size_t person_index, const VariantProbabilities &variant);
+    /** @brief Continues an initialized population through the infection history from its current day, stopping
+     * before `up_to`. The result is identical to initializing the population up to `up_to` from scratch.
+     */
+    std::vector<DailySummary> AdvancePopulation(sim::Population &population, date::sys_days up_to);
 
-    void ApplyVaccines(sim::Population &population, const std::unordered_map<int, data::VaccineHistory> &vaccines);
+    void InfectPerson(sim::Population &population, size_t person_index, const VariantProbabilities &variant,
+                      Probabilities &prob);
+
+    /** @brief Infects a member of the population with an incubation period and natural immunity scalar which have
+     * already been drawn
+     */
+    void InfectPerson(sim::Population &population, size_t person_index, const VariantProbabilities &variant,
+                      int incubation, float natural_immunity_scalar);
+
+    void ApplyVaccines(sim::Population &population);
 
     inline void SetProbabilities(double p_self) { contact_probability_ = p_self; }
 
+    /** @brief Sets the run number, which selects the random streams used by the vaccination and simulation steps. Two
+     * simulators with the same seed and run number produce identical results from identical populations.
+     */
+    inline void SetRun(uint32_t run) { run_ = run; }
+
+    /** @brief Overrides the prefetch batch size from the options, which only changes the speed of the simulation
+     */
+    inline void SetPrefetchBatch(int batch) { options_.prefetch_batch = batch; }
+
+    /** @brief The number of carriers below which a day currently runs on the calling thread alone
+     */
+    [[nodiscard]] inline size_t SerialThreshold() const { return serial_threshold_; }
+
+    [[nodiscard]] inline const ScheduleStats &Schedule() const { return schedule_; }
+
     DailySummary SimulateDay(sim::Population &population);
 
 #ifdef PERF_MEASURE
     PerfTimer loop_timer;
     PerfTimer remove_timer;
     PerfTimer infect_timer;
-    long alloc{};
 #endif
 
   private:
     double contact_probability_{};
-    std::shared_ptr<const VariantDictionary> variants_;
+    std::shared_ptr<const SimulationPlan> plan_;
     data::ProgramOptions options_;
 
-    Probabilities prob_{};
+    uint64_t seed_;
+    uint32_t run_{};
+
+    ImmunityBitsets immunity_bits_;
+    std::shared_ptr<ThreadPool> pool_;
+
+    // Days with fewer carriers than the threshold run on the calling thread alone, since splitting them over the pool
+    // costs more than it saves. Unless the options fix it, the threshold follows from the cost of handing a loop to
+    // the pool, which the pool measures once (see ThreadPool::DispatchNanoseconds), and a running average of the
+    // cost of a carrier.
+    double dispatch_ns_{};
+    double carrier_ns_{};
+    size_t serial_threshold_{};
+    ScheduleStats schedule_;
+
+    InfectionClaims claims_;
+    PerThread<DailyTally> tallies_;
+    std::vector<InfectionScratch> scratch_;
+
+    TransmissionTables transmission_tables_;
+
+    /** @brief Folds the time taken by the day's split steps into the average cost of a carrier, and updates the serial
+     * threshold from it
+     */
+    void RecordCarrierCost(size_t carriers, double nanoseconds, bool serial);
+
+    /** @brief The grain to split `count` items of a day's step into, which keeps them together on serial days
+     */
+    [[nodiscard]] inline size_t DayGrain(bool serial, size_t count, size_t grain) const {
+        return serial ? std::max<size_t>(count, 1) : grain;
+    }
+
+    void ApplyVaccines(sim::Population &population, uint32_t run);
+    std::vector<DailySummary> ReplayHistory(sim::Population &population, int max_day);
+
+    /** @brief Finds the day's transmissions by drawing each carrier's contacts and rolling each one for infection,
+     * and claims their targets
+     */
+    void TraceCarrierContacts(sim::Population &population, bool use_bitsets, bool serial);
+
+    /** @brief Finds the day's transmissions by sampling their number per variant from the carriers' total
+     * infectivity, so that the cost grows with the transmissions rather than with carriers times contacts, and claims
+     * their targets
+     */
+    void SampleForceOfInfection(sim::Population &population, bool use_bitsets);
+
+    /** @brief A member reached by a transmission of a variant, waiting to be screened for immunity
+     */
+    struct PendingContact {
+        size_t index;
+        size_t variant_index;
+    };
+
+    static constexpr size_t kMaxPrefetchBatch = 256;
+
+    // The fewest carriers handed to a thread at once, and the number of claim words applied as one chunk. The claims
+    // are split into fixed chunks rather than one per thread so that the order of the infections doesn't depend on
+    // the number of threads.
+    static constexpr size_t kMinCarrierChunk = 256;
+    static constexpr size_t kClaimWordsPerChunk = 512;
+
+    /** @brief Claims every contact of a batch who isn't already infectious or immune. The records of the whole batch
+     * are prefetched first, so that the cache misses they cause overlap.
+     */
+    void ScreenContacts(const sim::Population &population, bool use_bitsets, const PendingContact *contacts,
+                        size_t count, DailyTally &tally);
+
+    /** @brief Infects everyone who was claimed during the day, spreading the chunks of claims over threads
+     */
+    void ApplyClaims(sim::Population &population, bool serial);
+
+    /** @brief Writes an infection into a member's record and counts it in `tally`. Nothing shared between members is
+     * touched, so different members may be written from different threads at once.
+     */
+    void WriteInfection(sim::Population &population, size_t person_index, const VariantProbabilities &variant,
+                        int incubation, float natural_immunity_scalar, DailyTally &tally) const;
+
+    /** @brief Adds a member whose infection was written by WriteInfection to the infectious set and to everything that
+     * follows changes to the population
+     */
+    void RegisterInfection(sim::Population &population, size_t person_index, const VariantProbabilities &variant);
+
+    /** @brief Takes everyone whose infectious period ended today off the infectious set
+     */
+    void RemoveRecovered(sim::Population &population);
 };
 
 
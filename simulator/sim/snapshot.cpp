@@ -0,0 +1,228 @@
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <type_traits>
+
+namespace {
+
+    /** @brief 64 bit FNV-1a hash over the bytes of trivially copyable values
+     */
+    class Fnv1a {
+    public:
+        template <typename T>
+        void Add(const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            AddBytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void AddRange(const std::vector<T> &values) {
+            Add(values.size());
+            for (const auto &v : values) Add(v);
+        }
+
+        void AddBytes(const void *data, size_t size) {
+            const auto *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; ++i) {
+                state_ ^= bytes[i];
+                state_ *= 1099511628211ull;
+            }
+        }
+
+        [[nodiscard]] uint64_t Value() const { return state_; }
+
+    private:
+        uint64_t state_{14695981039346656037ull};
+    };
+
+    void AddFunction(Fnv1a &hash, const sim::data::DiscreteFunction &f) {
+        hash.Add(f.offset);
+        hash.AddRange(f.values);
+    }
+
+    constexpr char kMagic[8] = {'D', 'S', 'I', 'M', 'P', 'O', 'P', '\0'};
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t key;
+        uint64_t people;
+        uint64_t slots;
+        uint64_t summaries;
+        uint64_t infectious_count;
+        int32_t counters[11];
+    };
+
+    // Every block in the file starts on an 8 byte boundary
+    inline size_t Padded(size_t size) { return (size + 7) & ~size_t{7}; }
+}
+
+uint64_t sim::PopulationSnapshot::Key(const SimulationPlan &plan, int last_day) {
+    static_assert(std::is_trivially_copyable_v<DailySummary>);
+
+    Fnv1a hash;
+    hash.Add(kSnapshotVersion);
+    hash.Add(sizeof(Variant));
+    hash.Add(sizeof(ImmunityWindow));
+    hash.Add(sizeof(StoredDay));
+    hash.Add(sizeof(StoredScalar));
+    hash.Add(sizeof(StoredAge));
+
+    hash.Add(plan.seed);
+    hash.Add(plan.population_scale);
+    hash.Add(plan.state_info.population);
+    hash.AddRange(plan.state_info.ages);
+    hash.Add(plan.options.full_history);
+    hash.Add(plan.options.expensive_stats);
+    hash.Add(plan.options.sparse_population);
+
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        const auto &properties = plan.variants[v]->Properties();
+        hash.AddRange(properties.incubation);
+        AddFunction(hash, properties.infectivity);
+        AddFunction(hash, properties.vax_immunity);
+        AddFunction(hash, properties.natural_immunity);
+    }
+
+    // Only the history up to the last initialized day matters, plus the vaccination look-ahead, so that runs which
+    // differ only in their end date share snapshots
+    hash.Add(plan.history_first_day);
+    hash.Add(last_day);
+    for (int day = plan.history_first_day; day <= last_day; ++day) {
+        hash.Add(plan.HasInfections(day) ? plan.TotalInfections(day) : SimulationPlan::kNoRecord);
+        hash.Add(plan.TotalCompletedVax(day + 21));
+        hash.Add(plan.VariantFractionsOn(day));
+    }
+
+    return hash.Value();
+}
+
+std::string sim::PopulationSnapshot::Path(const std::string &cache_dir, uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "pop-%016llx.bin", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(cache_dir) / name).string();
+}
+
+bool sim::PopulationSnapshot::Load(const std::string &file_name, uint64_t key, Population &population,
+                                   std::vector<DailySummary> &summaries) {
+    std::error_code ec;
+    auto file_size = std::filesystem::file_size(file_name, ec);
+    std::ifstream in(file_name, std::ios::binary);
+    if (ec || !in || file_size < sizeof(Header)) return false;
+
+    Header header{};
+    in.read(reinterpret_cast<char *>(&header), sizeof(Header));
+    if (!in || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kSnapshotVersion ||
+        header.header_size != sizeof(Header) || header.key != key || header.people != population.people.size() ||
+        header.infectious_count > header.people || (header.slots != 0) != population.people.IsSparse()) {
+        return false;
+    }
+
+    // Sparse populations store as many records as they had slots, everyone else one per member. Check the file
+    // holds everything the header promises before touching the population.
+    const size_t records = population.people.IsSparse() ? header.slots : header.people;
+    if (records > header.people + 1) return false;
+    size_t expected = Padded(sizeof(Header));
+    population.people.ForEachColumn([&](const auto &values) { expected += Padded(records * sizeof(values[0])); });
+    expected += header.summaries * sizeof(DailySummary);
+    if (file_size != expected) return false;
+
+    if (population.people.IsSparse()) population.people.ResizeSlots(records);
+    in.seekg(static_cast<std::streamoff>(Padded(sizeof(Header))));
+    population.people.ForEachColumn([&](auto &values) {
+        const auto bytes = values.size() * sizeof(values[0]);
+        in.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(bytes));
+        in.ignore(static_cast<std::streamsize>(Padded(bytes) - bytes));
+    });
+    summaries.resize(header.summaries);
+    in.read(reinterpret_cast<char *>(summaries.data()),
+            static_cast<std::streamsize>(header.summaries * sizeof(DailySummary)));
+
+    // The file changed under us after all
+    if (!in) {
+        population.Reset();
+        summaries.clear();
+        return false;
+    }
+
+    const auto *c = header.counters;
+    population.today = c[0];
+    population.vaccine_saves = c[1];
+    population.natural_saves = c[2];
+    population.total_infections = c[3];
+    population.total_vaccinated = c[4];
+    population.never_infected = c[5];
+    population.total_delta_infections = c[6];
+    population.total_alpha_infections = c[7];
+    population.reinfections = c[8];
+    population.vaccinated_infections = c[9];
+    population.scale_ = c[10];
+    population.people.RebuildSlotTable();
+    population.RebuildInfectious(header.infectious_count);
+    population.recoveries_.Rebuild(population.people, population.today);
+    population.Invalidate();
+    return true;
+}
+
+bool sim::PopulationSnapshot::Save(const std::string &file_name, uint64_t key, const Population &population,
+                                   const std::vector<DailySummary> &summaries) {
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSnapshotVersion;
+    header.header_size = sizeof(Header);
+    header.key = key;
+    header.people = population.people.size();
+    header.slots = population.people.IsSparse() ? population.people.SlotCount() : 0;
+    header.summaries = summaries.size();
+    header.infectious_count = population.InfectiousCount();
+    int32_t counters[] = {population.today,
+                          population.vaccine_saves,
+                          population.natural_saves,
+                          population.total_infections,
+                          population.total_vaccinated,
+                          population.never_infected,
+                          population.total_delta_infections,
+                          population.total_alpha_infections,
+                          population.reinfections,
+                          population.vaccinated_infections,
+                          population.scale_};
+    static_assert(sizeof(counters) == sizeof(header.counters));
+    std::memcpy(header.counters, counters, sizeof(counters));
+
+    std::error_code ec;
+    auto path = std::filesystem::path(file_name);
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    auto temp = path;
+    temp += ".tmp" + std::to_string(std::random_device{}());
+    {
+        std::ofstream out(temp, std::ios::binary);
+        const char zeros[8]{};
+        auto write = [&](const void *data, size_t bytes) {
+            out.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+            out.write(zeros, static_cast<std::streamsize>(Padded(bytes) - bytes));
+        };
+
+        write(&header, sizeof(header));
+        population.people.ForEachColumn(
+                [&](const auto &values) { write(values.data(), values.size() * sizeof(values[0])); });
+        out.write(reinterpret_cast<const char *>(summaries.data()),
+                  static_cast<std::streamsize>(summaries.size() * sizeof(DailySummary)));
+        if (!out) {
+            out.close();
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "covid.hpp"
+#include "plan.hpp"
+#include "population/population.hpp"
+
+namespace sim {
+
+    /** @brief Bumped whenever the snapshot file layout or the meaning of its contents changes. It is part of every
+     * snapshot key, so files written by other versions are never read.
+     */
+    constexpr uint32_t kSnapshotVersion = 4;
+
+    /** @class PopulationSnapshot
+     *
+     * @brief Stores initialized populations in a content-addressed cache directory
+     *
+     * @summary Initializing a population replays the whole infection history, and the result only depends on the
+     * parts of the plan that are hashed into the snapshot key. A snapshot holds the population's counters, every
+     * person column and the daily summaries produced while initializing. The random streams are counter based and
+     * keyed by seed, run, day and stream, so there is no generator state to save beyond the seed that is already in
+     * the key. Files are written to a temporary name and renamed into place so that concurrent processes sharing a
+     * cache directory never see a partial snapshot. Loading is a cached read: the columns are read straight from the
+     * file into the population's own storage, which costs one pass over the file instead of replaying the history.
+     */
+    class PopulationSnapshot {
+    public:
+        /** @brief Hashes everything that affects initializing a population under `plan` through `last_day`
+         */
+        static uint64_t Key(const SimulationPlan &plan, int last_day);
+
+        static std::string Path(const std::string &cache_dir, uint64_t key);
+
+        /** @brief Loads a snapshot into a population of the same size, returning false and leaving the population
+         * untouched if the file doesn't exist or doesn't match the key and population. If the file passes those
+         * checks but then can't be read in full, the population is reset.
+         */
+        static bool Load(const std::string &file_name, uint64_t key, Population &population,
+                         std::vector<DailySummary> &summaries);
+
+        /** @brief Writes a snapshot, returning false if the file couldn't be written
+         */
+        static bool Save(const std::string &file_name, uint64_t key, const Population &population,
+                         const std::vector<DailySummary> &summaries);
+    };
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace sim {
+
+    /** @class QuantizedScalar
+     *
+     * @brief A value in [0, 1] stored in 16 bits, which reads and writes like a float
+     *
+     * @summary Values are rounded to the nearest multiple of 1/65535 when stored. Everything that depends on a stored
+     * scalar (the immunity checks and the immunity windows) reads it back from the population, so a packed build is
+     * consistent with itself, it just draws from a slightly coarser distribution than a full build.
+     */
+    class QuantizedScalar {
+    public:
+        static constexpr float kSteps = 65535.f;
+
+        QuantizedScalar() = default;
+
+        QuantizedScalar(float value)
+            : bits_(static_cast<uint16_t>(std::lround(std::clamp(value, 0.f, 1.f) * kSteps))) {}
+
+        inline operator float() const { return static_cast<float>(bits_) / kSteps; }
+
+    private:
+        uint16_t bits_{};
+    };
+
+    /* Storage types of the per-member columns of a population (see People). Days are always handled as int and
+     * scalars as float, these are only the types they're kept in. Building with DELTA_SIM_PACKED narrows them, which
+     * takes a member's record across all columns from 70 to 40 bytes (see People::kBytesPerRecord). CompilePlan
+     * checks that every day a plan can produce fits in StoredDay, and that every age bucket fits in StoredAge.
+     */
+#ifdef DELTA_SIM_PACKED
+    using StoredDay = int16_t;
+    using StoredDaySpan = uint16_t;
+    using StoredScalar = QuantizedScalar;
+    using StoredAge = uint8_t;
+#else
+    using StoredDay = int;
+    using StoredDaySpan = uint32_t;
+    using StoredScalar = float;
+    using StoredAge = int;
+#endif
+
+    /** @brief The largest stored day, which is reserved as the "never" sentinel of the day columns. Real days have to
+     * be below it.
+     */
+    constexpr int kMaxStoredDay = std::numeric_limits<StoredDay>::max();
+    constexpr int kMinStoredDay = std::numeric_limits<StoredDay>::min();
+
+    /** @brief Clamps a day into the range of StoredDay, for the open ends of ranges of days
+     */
+    inline constexpr StoredDay ClampToStoredDay(int day) {
+        return static_cast<StoredDay>(std::clamp(day, kMinStoredDay, kMaxStoredDay));
+    }
+
+}
@@ -0,0 +1,171 @@
+#include "thread_pool.hpp"
+#include <chrono>
+
+namespace {
+    // The pool each thread belongs to and its index there, unset for threads created elsewhere
+    thread_local const sim::ThreadPool *current_pool = nullptr;
+    thread_local size_t current_index = 0;
+
+    // How many times an idle thread looks for work before going to sleep
+    constexpr int kIdleSpins = 64;
+}
+
+sim::ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+        queues_.back()->ring.resize(64);
+    }
+
+    for (size_t i = 1; i < threads; ++i) {
+        threads_.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+sim::ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_) thread.join();
+}
+
+double sim::ThreadPool::DispatchNanoseconds() {
+    std::call_once(dispatch_once_, [this] {
+        if (Size() == 1) return;
+
+        using Clock = std::chrono::steady_clock;
+        constexpr int kRepeats = 16;
+        std::atomic<size_t> touched{0};
+        auto body = [&](size_t first, size_t last) { touched.fetch_add(last - first, std::memory_order_relaxed); };
+        ParallelFor(0, Size(), 1, body);
+
+        Clock::duration total{};
+        for (int repeat = 0; repeat < kRepeats; ++repeat) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            auto start = Clock::now();
+            ParallelFor(0, Size(), 1, body);
+            total += Clock::now() - start;
+        }
+        dispatch_ns_ = std::chrono::duration<double, std::nano>(total).count() / kRepeats;
+    });
+    return dispatch_ns_;
+}
+
+size_t sim::ThreadPool::WorkerIndex() const {
+    return current_pool == this ? current_index : 0;
+}
+
+void sim::ThreadPool::Push(size_t worker, const Task &task) {
+    auto &queue = *queues_[worker];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.count == queue.ring.size()) {
+            // Unroll the ring into a buffer twice the size
+            std::vector<Task> grown(queue.ring.size() * 2);
+            for (size_t i = 0; i < queue.count; ++i) {
+                grown[i] = queue.ring[(queue.head + i) % queue.ring.size()];
+            }
+            queue.ring.swap(grown);
+            queue.head = 0;
+        }
+        queue.ring[(queue.head + queue.count) % queue.ring.size()] = task;
+        queue.count++;
+    }
+
+    queued_.fetch_add(1);
+    if (sleeping_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_.notify_one();
+    }
+}
+
+bool sim::ThreadPool::TakeBack(size_t worker, Task &task, const Group *only) {
+    auto &queue = *queues_[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.count == 0) return false;
+
+    auto &back = queue.ring[(queue.head + queue.count - 1) % queue.ring.size()];
+    if (only && back.group != only) return false;
+    task = back;
+    queue.count--;
+    queued_.fetch_sub(1);
+    return true;
+}
+
+bool sim::ThreadPool::StealFront(size_t victim, Task &task, const Group *only) {
+    auto &queue = *queues_[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.count == 0) return false;
+
+    auto &front = queue.ring[queue.head];
+    if (only && front.group != only) return false;
+    task = front;
+    queue.head = (queue.head + 1) % queue.ring.size();
+    queue.count--;
+    queued_.fetch_sub(1);
+    return true;
+}
+
+bool sim::ThreadPool::FindTask(size_t worker, Task &task, const Group *only) {
+    if (TakeBack(worker, task, only)) return true;
+    if (queued_.load(std::memory_order_relaxed) == 0) return false;
+
+    for (size_t k = 1; k < queues_.size(); ++k) {
+        if (StealFront((worker + k) % queues_.size(), task, only)) return true;
+    }
+    return false;
+}
+
+void sim::ThreadPool::Execute(size_t worker, Task task) {
+    // Queue the upper halves, biggest first, so that thieves take the largest pieces left
+    while (task.end - task.begin > task.grain) {
+        auto middle = task.begin + (task.end - task.begin) / 2;
+        task.group->pending.fetch_add(1, std::memory_order_relaxed);
+        Push(worker, Task{task.invoke, task.body, middle, task.end, task.grain, task.group});
+        task.end = middle;
+    }
+
+    task.invoke(task.body, task.begin, task.end);
+    task.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void sim::ThreadPool::Wait(size_t worker, Group &group) {
+    Task task{};
+    while (group.pending.load(std::memory_order_acquire) != 0) {
+        if (FindTask(worker, task, &group)) {
+            Execute(worker, task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void sim::ThreadPool::WorkerLoop(size_t worker) {
+    current_pool = this;
+    current_index = worker;
+
+    Task task{};
+    while (true) {
+        bool found = false;
+        for (int spin = 0; spin < kIdleSpins && !found; ++spin) {
+            found = FindTask(worker, task, nullptr);
+            if (!found) std::this_thread::yield();
+        }
+
+        if (found) {
+            Execute(worker, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleeping_.fetch_add(1);
+        wake_.wait(lock, [this]() { return stop_ || queued_.load() > 0; });
+        sleeping_.fetch_sub(1);
+        if (stop_) return;
+    }
+}
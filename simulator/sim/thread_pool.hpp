@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sim {
+
+    /** @brief The size of the blocks the caches move data around in, which no two threads' writes should share
+     */
+    constexpr size_t kCacheLine = 64;
+
+    /** @class ThreadPool
+     *
+     * @brief A fixed set of threads which are kept alive between parallel loops, balanced by work stealing
+     *
+     * @summary A loop over a range starts as a single task on the calling thread, which splits it in halves down to a
+     * grain size, queueing each upper half and carrying on with the lower one. Every thread takes work from the back of
+     * its own queue, and idle threads steal from the front of the others', where the biggest pieces are, so uneven
+     * work is rebalanced by splitting only where it's needed. Idle threads spin briefly and then sleep until more work
+     * is queued, so a loop costs no thread wakeups when the pool is already busy.
+     *
+     * The thread that starts a loop takes part in it and helps with the loop's tasks until all of them are done. Loops
+     * may be started from inside the tasks of another loop of the same pool. A thread waiting for a loop only runs that
+     * loop's tasks, so per-thread state (see WorkerIndex) is never entered again by an unrelated task while it's in
+     * use. The pool counts as one of its threads the single outside thread which drives it, which has index 0.
+     */
+    class ThreadPool {
+    public:
+        /** @brief Creates a pool of `threads` threads including the calling one, or one per hardware thread if 0
+         */
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /** @brief The number of threads which take part in loops, including the one driving the pool
+         */
+        [[nodiscard]] inline size_t Size() const { return queues_.size(); }
+
+        /** @brief The index of the calling thread in this pool, in [0, Size()). Any thread which isn't one of the
+         * pool's own gets 0.
+         */
+        [[nodiscard]] size_t WorkerIndex() const;
+
+        /** @brief The time it takes to hand a loop to every thread of the pool and wait for it, in nanoseconds. It's
+         * measured on the first call, with loops of one trivial item per thread started after the threads have had
+         * time to go idle as they do between simulated days, and every later call returns the same value. The first
+         * call should be made from outside the pool's tasks.
+         */
+        [[nodiscard]] double DispatchNanoseconds();
+
+        /** @brief Calls `body(first, last)` on subranges which together cover [begin, end) exactly once, and returns
+         * when all of them are done. Subranges are never split below `grain` elements. The body must not throw.
+         */
+        template <typename F>
+        void ParallelFor(size_t begin, size_t end, size_t grain, F &&body) {
+            if (begin >= end) return;
+            grain = std::max<size_t>(grain, 1);
+            if (queues_.size() == 1 || end - begin <= grain) {
+                body(begin, end);
+                return;
+            }
+
+            using Body = std::remove_reference_t<F>;
+            Group group;
+            group.pending.store(1, std::memory_order_relaxed);
+            Task root{[](void *b, size_t first, size_t last) { (*static_cast<Body *>(b))(first, last); },
+                      const_cast<void *>(static_cast<const void *>(&body)), begin, end, grain, &group};
+
+            auto worker = WorkerIndex();
+            Execute(worker, root);
+            Wait(worker, group);
+        }
+
+    private:
+        struct Group {
+            std::atomic<size_t> pending{0};
+        };
+
+        struct Task {
+            void (*invoke)(void *body, size_t first, size_t last);
+            void *body;
+            size_t begin;
+            size_t end;
+            size_t grain;
+            Group *group;
+        };
+
+        /** @brief A double-ended queue of tasks in a ring buffer, which keeps its capacity once grown
+         */
+        struct alignas(kCacheLine) Queue {
+            std::mutex mutex;
+            std::vector<Task> ring;
+            size_t head{};
+            size_t count{};
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::vector<std::thread> threads_;
+
+        // Tasks sitting in any queue, and threads asleep waiting for one
+        std::atomic<size_t> queued_{0};
+        std::atomic<size_t> sleeping_{0};
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_;
+        bool stop_{};
+
+        std::once_flag dispatch_once_;
+        double dispatch_ns_{};
+
+        void Push(size_t worker, const Task &task);
+        bool TakeBack(size_t worker, Task &task, const Group *only);
+        bool StealFront(size_t victim, Task &task, const Group *only);
+
+        /** @brief Finds a task in the worker's own queue or else in another one, only from `only` if given
+         */
+        bool FindTask(size_t worker, Task &task, const Group *only);
+
+        void Execute(size_t worker, Task task);
+        void Wait(size_t worker, Group &group);
+        void WorkerLoop(size_t worker);
+    };
+
+}
@@ -0,0 +1,48 @@
+#include "transmission_tables.hpp"
+#include <algorithm>
+#include <cmath>
+#include "plan.hpp"
+
+namespace {
+    /** @brief The probabilities of 0, 1, 2... successes in n trials of probability p, up to where the remaining tail
+     * is below double precision
+     */
+    std::vector<double> BinomialWeights(long n, double p) {
+        if (n <= 0 || p <= 0) return {1.0};
+        if (p >= 1) {
+            std::vector<double> weights(static_cast<size_t>(n) + 1, 0.0);
+            weights.back() = 1.0;
+            return weights;
+        }
+
+        double mean = static_cast<double>(n) * p;
+        auto last = std::min<long>(n, static_cast<long>(std::ceil(mean + 12 * std::sqrt(mean * (1 - p)) + 20)));
+        double log_norm = std::lgamma(static_cast<double>(n) + 1);
+        std::vector<double> weights;
+        for (long k = 0; k <= last; ++k) {
+            auto kd = static_cast<double>(k);
+            weights.push_back(std::exp(log_norm - std::lgamma(kd + 1) - std::lgamma(static_cast<double>(n - k) + 1) +
+                                       kd * std::log(p) + static_cast<double>(n - k) * std::log1p(-p)));
+        }
+        return weights;
+    }
+}
+
+void sim::TransmissionTables::Prepare(const SimulationPlan &plan, double contact_probability,
+                                      size_t population_size) {
+    if (contact_probability == contact_probability_ && population_size == population_size_)
+        return;
+
+    auto normalized_contact = contact_probability / static_cast<double>(population_size);
+    for (size_t v = kFirstVariant; v < kVariantCount; ++v) {
+        const auto &values = plan.variants[v]->Properties().infectivity.values;
+        tables_[v].clear();
+        for (double infection_p : values) {
+            auto p = std::clamp(infection_p * normalized_contact, 0.0, 1.0);
+            tables_[v].emplace_back(BinomialWeights(static_cast<long>(population_size), p));
+        }
+    }
+
+    contact_probability_ = contact_probability;
+    population_size_ = population_size;
+}
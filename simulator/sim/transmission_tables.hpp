@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "alias_table.hpp"
+#include "covid.hpp"
+
+namespace sim {
+
+    struct SimulationPlan;
+
+    /** @class TransmissionTables
+     *
+     * @brief The distribution of a carrier's successful transmissions in a day, for every point of every variant's
+     * infectivity curve
+     *
+     * @summary The number of successful transmissions from a carrier only depends on the contact probability, the
+     * population size and the carrier's infectivity, which takes one of the values of its variant's infectivity
+     * curve. Each of those distributions is held as an alias table, and they're only rebuilt when the first two change.
+     */
+    class TransmissionTables {
+    public:
+        /** @brief Builds the tables for a contact probability and population size, unless they're already built
+         */
+        void Prepare(const SimulationPlan &plan, double contact_probability, size_t population_size);
+
+        /** @brief The distribution of transmissions from a carrier of a variant at a point of its infectivity curve
+         */
+        [[nodiscard]] inline const AliasTable &At(size_t variant_index, size_t curve_index) const {
+            return tables_[variant_index][curve_index];
+        }
+
+    private:
+        std::array<std::vector<AliasTable>, kVariantCount> tables_;
+        double contact_probability_{-1};
+        size_t population_size_{};
+    };
+
+}
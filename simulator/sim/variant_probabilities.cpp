@@ -1,37 +1,81 @@
 #include "variant_probabilities.hpp"
+#include <algorithm>
+#include <limits>
 
 sim::VariantProbabilities::VariantProbabilities(const data::VariantProperties& variant_properties, Variant variant)
         : variant_(variant),
-        incubation_(variant_properties.incubation.begin(), variant_properties.incubation.end()),
-        properties_(variant_properties) {}
+        incubation_(IncubationWeights(variant_properties.incubation)),
+        properties_(variant_properties),
+        natural_shape_(AnalyzeCurve(variant_properties.natural_immunity)),
+        vax_shape_(AnalyzeCurve(variant_properties.vax_immunity)),
+        recovery_offset_(FindRecoveryOffset(variant_properties.infectivity)) {}
 
-double sim::VariantProbabilities::GetInfectivity(int days_from_symptoms) const {
-    return properties_.infectivity(days_from_symptoms);
+int sim::VariantProbabilities::FindRecoveryOffset(const data::DiscreteFunction &infectivity) {
+    // Past the end of the values the curve holds its last value, so there's nothing new to find beyond it
+    int last = std::max(1, static_cast<int>(infectivity.values.size()) - 1 - infectivity.offset);
+    for (int day = 1; day <= last; ++day) {
+        if (infectivity(day) <= 0)
+            return day;
+    }
+    return kNoRecovery;
 }
 
-int sim::VariantProbabilities::GetRandomIncubation(std::mt19937_64 &mt) const {
-    std::uniform_real_distribution<double> dist(0, 1);
-    auto value = dist(mt);
-    for (int i = 0; i < incubation_.size(); ++i) {
-        if (value <= incubation_[i])
-            return i;
+std::vector<double> sim::VariantProbabilities::IncubationWeights(const std::vector<double> &cdf) {
+    // The incubation is given as a cumulative distribution over days, with any remaining probability falling on the
+    // day after the last entry
+    std::vector<double> weights;
+    double previous = 0;
+    for (double value : cdf) {
+        weights.push_back(std::max(0.0, value - previous));
+        previous = std::max(previous, value);
     }
-    return (int)incubation_.size();
+    weights.push_back(std::max(0.0, 1.0 - previous));
+    return weights;
 }
 
-double sim::VariantProbabilities::GetVaxImmunity(int days_from_vax) const {
-    return properties_.vax_immunity(days_from_vax);
+sim::ImmunityWindow sim::VariantProbabilities::NaturalImmunityWindow(float scalar, int infected_day) const {
+    return ProtectedWindow(properties_.natural_immunity, natural_shape_, scalar, infected_day);
 }
 
-double sim::VariantProbabilities::GetNaturalImmunity(int days_from_infection) const {
-    return properties_.natural_immunity(days_from_infection);
+sim::ImmunityWindow sim::VariantProbabilities::VaxImmunityWindow(float scalar, int vaccination_day) const {
+    return ProtectedWindow(properties_.vax_immunity, vax_shape_, scalar, vaccination_day);
 }
 
-bool sim::VariantProbabilities::IsPersonNatImmune(const sim::Person &person, int today) const {
-    return person.IsInfected() && person.natural_immunity_scalar <= GetNaturalImmunity(today - person.infected_day);
+int sim::VariantProbabilities::WindowHorizon() const {
+    const auto &n = properties_.natural_immunity;
+    const auto &v = properties_.vax_immunity;
+    return std::max(static_cast<int>(n.values.size()) - n.offset, static_cast<int>(v.values.size()) - v.offset);
 }
 
-bool sim::VariantProbabilities::IsPersonVaxImmune(const sim::Person &person, int today) const {
-    return person.is_vaccinated &&
-           person.vaccine_immunity_scalar <= GetVaxImmunity(today - person.vaccination_day);
+sim::VariantProbabilities::CurveShape sim::VariantProbabilities::AnalyzeCurve(const data::DiscreteFunction &f) {
+    const auto &v = f.values;
+    if (v.empty()) return {};
+
+    size_t i = 1;
+    while (i < v.size() && v[i] >= v[i - 1]) ++i;
+    int peak = static_cast<int>(i) - 1;
+    while (i < v.size() && v[i] <= v[i - 1]) ++i;
+
+    return {i == v.size(), peak};
+}
+
+sim::ImmunityWindow sim::VariantProbabilities::ProtectedWindow(const data::DiscreteFunction &f,
+                                                               const CurveShape &shape, float scalar, int start_day) {
+    // An individual is protected on any day where scalar <= f(day - start_day). On a unimodal curve the indices which
+    // satisfy that form one contiguous run around the peak, found by binary searching each side of it.
+    const auto &v = f.values;
+    const double s = scalar;
+    if (v[shape.peak] < s) return {};
+
+    auto peak_it = v.begin() + shape.peak;
+    auto first = std::partition_point(v.begin(), peak_it, [s](double x) { return x < s; });
+    auto last = std::partition_point(peak_it, v.end(), [s](double x) { return x >= s; }) - 1;
+
+    // The curve is clamped at both ends, so a run touching either end extends indefinitely
+    auto first_index = static_cast<int>(first - v.begin());
+    auto last_index = static_cast<int>(last - v.begin());
+    int first_day = first_index == 0 ? std::numeric_limits<int>::min() : start_day + first_index - f.offset;
+    int last_day = last_index == static_cast<int>(v.size()) - 1 ? std::numeric_limits<int>::max()
+                                                                 : start_day + last_index - f.offset;
+    return ImmunityWindow::Between(first_day, last_day);
 }
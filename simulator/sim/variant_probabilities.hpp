@@ -1,28 +1,140 @@
 #pragma once
 #include <random>
+#include "alias_table.hpp"
 #include "data.hpp"
-#include "population/person.hpp"
+#include "population/people.hpp"
+#include "probabilities.hpp"
 
 namespace sim {
     class VariantProbabilities {
     public:
         VariantProbabilities(const data::VariantProperties& variant_properties, Variant variant);
 
-        [[nodiscard]] double GetInfectivity(int days_from_symptoms) const;
-        [[nodiscard]] double GetVaxImmunity(int days_from_vax) const;
-        [[nodiscard]] double GetNaturalImmunity(int days_from_infection) const;
+        [[nodiscard]] inline double GetInfectivity(int days_from_symptoms) const {
+            return properties_.infectivity(days_from_symptoms);
+        }
 
-        [[nodiscard]] int GetRandomIncubation(std::mt19937_64 &mt) const;
+        [[nodiscard]] inline double GetVaxImmunity(int days_from_vax) const {
+            return properties_.vax_immunity(days_from_vax);
+        }
 
-        [[nodiscard]] bool IsPersonVaxImmune(const Person& person, int today) const;
-        [[nodiscard]] bool IsPersonNatImmune(const Person& person, int today) const;
+        [[nodiscard]] inline double GetNaturalImmunity(int days_from_infection) const {
+            return properties_.natural_immunity(days_from_infection);
+        }
+
+        [[nodiscard]] inline int GetRandomIncubation(Probabilities &prob) const {
+            return incubation_.Sample(prob.UniformScalar());
+        }
+
+        /** @summary Draws the incubation periods for `count` new infections, one from each of the uniform values
+         */
+        inline void SampleIncubations(const double *uniforms, int *incubations, size_t count) const {
+            incubation_.Sample(uniforms, incubations, count);
+        }
+
+        /** @summary Computes the days on which someone infected on `infected_day` who drew `scalar` is protected
+         * against this variant by natural immunity. Only meaningful if HasNaturalWindows() is true.
+         */
+        [[nodiscard]] ImmunityWindow NaturalImmunityWindow(float scalar, int infected_day) const;
+
+        /** @summary Computes the days on which someone vaccinated on `vaccination_day` who drew `scalar` is protected
+         * against this variant by the vaccine. Only meaningful if HasVaxWindows() is true.
+         */
+        [[nodiscard]] ImmunityWindow VaxImmunityWindow(float scalar, int vaccination_day) const;
+
+        /** @summary Whether the natural immunity curve is unimodal, in which case every individual's protection is a
+         * single contiguous window that can be computed when they are infected
+         */
+        [[nodiscard]] inline bool HasNaturalWindows() const { return natural_shape_.unimodal; }
+        [[nodiscard]] inline bool HasVaxWindows() const { return vax_shape_.unimodal; }
+
+        /** @summary The most days after infection or vaccination at which a finite end of an immunity window can fall
+         */
+        [[nodiscard]] int WindowHorizon() const;
+
+        /** @summary Checks if the member of the population at `index` has vaccine immunity against this variant today.
+         * Uses the member's precomputed window when the curve allows it, otherwise evaluates the curve.
+         */
+        [[nodiscard]] inline bool IsPersonVaxImmune(const People& people, size_t index, int today) const {
+            return IsRecordVaxImmune(people, people.Slot(index), today);
+        }
+
+        /** @summary Checks if the member of the population at `index` has natural immunity against this variant today.
+         * Uses the member's precomputed window when the curve allows it, otherwise evaluates the curve.
+         */
+        [[nodiscard]] inline bool IsPersonNatImmune(const People& people, size_t index, int today) const {
+            return IsRecordNatImmune(people, people.Slot(index), today);
+        }
+
+        /** @summary The same checks on the record in a slot of the population's columns, see People::Slot
+         */
+        [[nodiscard]] inline bool IsRecordVaxImmune(const People& people, size_t slot, int today) const {
+            if (vax_shape_.unimodal)
+                return people.hot.vaccine_window[VariantIndex(variant_)][slot].Contains(today);
+            return people.hot.is_vaccinated[slot] &&
+                   people.hot.vaccine_immunity_scalar[slot] <= GetVaxImmunity(today - people.hot.vaccination_day[slot]);
+        }
+
+        [[nodiscard]] inline bool IsRecordNatImmune(const People& people, size_t slot, int today) const {
+            if (natural_shape_.unimodal)
+                return people.hot.natural_window[VariantIndex(variant_)][slot].Contains(today);
+            return people.hot.variant[slot] != Variant::None &&
+                   people.hot.natural_immunity_scalar[slot] <=
+                       GetNaturalImmunity(today - people.hot.infected_day[slot]);
+        }
+
+        /** @summary Starts loading the parts of a member's record which IsPersonNatImmune and IsPersonVaxImmune read
+         * first, so that several members can be fetched from memory at once before they're checked. In sparse storage
+         * the record can't be found without waiting on the table, so only the table is loaded.
+         */
+        inline void PrefetchPerson(const People& people, size_t index) const {
+            if (people.IsSparse()) {
+                people.PrefetchSlot(index);
+                return;
+            }
+            if (natural_shape_.unimodal) {
+                __builtin_prefetch(&people.hot.natural_window[VariantIndex(variant_)][index]);
+            } else {
+                __builtin_prefetch(&people.hot.variant[index]);
+            }
+            if (vax_shape_.unimodal) {
+                __builtin_prefetch(&people.hot.vaccine_window[VariantIndex(variant_)][index]);
+            } else {
+                __builtin_prefetch(&people.hot.is_vaccinated[index]);
+            }
+        }
+
+        /** @summary Value of RecoveryOffset for variants whose infectivity never drops to zero after symptom onset
+         */
+        static constexpr int kNoRecovery = -1;
+
+        /** @summary The number of days after symptom onset on which a carrier stops being infectious, which is the
+         * first day after onset with no infectivity
+         */
+        [[nodiscard]] inline int RecoveryOffset() const { return recovery_offset_; }
 
         [[nodiscard]] Variant GetVariant() const { return variant_; }
+
+        [[nodiscard]] const data::VariantProperties &Properties() const { return properties_; }
     private:
+        /** @brief Values of a curve rise (non-strictly) up to the peak index and fall (non-strictly) after it
+         */
+        struct CurveShape {
+            bool unimodal{};
+            int peak{};
+        };
+
+        static std::vector<double> IncubationWeights(const std::vector<double> &cdf);
+        static int FindRecoveryOffset(const data::DiscreteFunction &infectivity);
+        static CurveShape AnalyzeCurve(const data::DiscreteFunction &f);
+        static ImmunityWindow ProtectedWindow(const data::DiscreteFunction &f, const CurveShape &shape, float scalar,
+                                              int start_day);
+
         Variant variant_;
-        std::vector<double> incubation_;
+        AliasTable incubation_;
         data::VariantProperties properties_;
+        CurveShape natural_shape_;
+        CurveShape vax_shape_;
+        int recovery_offset_;
     };
-
-    using VariantDictionary = std::unordered_map<Variant, std::unique_ptr<VariantProbabilities>>;
 }
\ No newline at end of file
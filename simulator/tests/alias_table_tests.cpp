@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "../sim/alias_table.hpp"
+#include "../sim/probabilities.hpp"
+
+TEST(AliasTableTests, FrequenciesMatchWeights) {
+    std::vector<double> weights{0.5, 0.0, 3.0, 1.0, 0.25, 1.25};
+    sim::AliasTable table(weights);
+    ASSERT_EQ(weights.size(), table.size());
+
+    sim::Probabilities prob(11, 0, 0, 0);
+    const int draws = 600000;
+    std::vector<int> counts(weights.size());
+    for (int i = 0; i < draws; ++i) {
+        auto k = table.Sample(prob.UniformScalar());
+        ASSERT_GE(k, 0);
+        ASSERT_LT(k, static_cast<int>(weights.size()));
+        counts[k]++;
+    }
+
+    for (size_t k = 0; k < weights.size(); ++k) {
+        double p = weights[k] / 6.0;
+        EXPECT_NEAR(p, static_cast<double>(counts[k]) / draws, 5 * std::sqrt(p * (1 - p) / draws) + 1e-12) << k;
+    }
+}
+
+TEST(AliasTableTests, BatchMatchesSingleDraws) {
+    sim::AliasTable table({1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0});
+    sim::Probabilities prob(3, 0, 0, 0);
+
+    std::vector<double> uniforms(1000);
+    for (auto &u : uniforms) u = prob.UniformScalar();
+    std::vector<int> outcomes(uniforms.size());
+    table.Sample(uniforms.data(), outcomes.data(), uniforms.size());
+
+    for (size_t i = 0; i < uniforms.size(); ++i) {
+        EXPECT_EQ(table.Sample(uniforms[i]), outcomes[i]);
+    }
+}
+
+TEST(AliasTableTests, DegenerateWeights) {
+    EXPECT_EQ(0, sim::AliasTable(std::vector<double>{}).Sample(0.7));
+    EXPECT_EQ(0, sim::AliasTable({1.0}).Sample(0.999));
+    EXPECT_EQ(2, sim::AliasTable({0.0, 0.0, 2.0}).Sample(0.1));
+}
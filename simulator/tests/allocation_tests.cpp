@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "../sim/simulators.hpp"
+#include "test_plan.hpp"
+
+// These tests replace the global allocation functions to count every allocation, so they're built into an executable
+// of their own (gtest_alloc) and the rest of the tests run on the standard allocator
+
+namespace {
+    std::atomic<long> allocations{0};
+
+    void *CountedAllocation(std::size_t size, std::size_t alignment) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        size = size ? size : 1;
+        void *p = alignment > alignof(std::max_align_t)
+                      ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+                      : std::malloc(size);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+
+    // Kept out of line so that the compiler doesn't pair an inlined allocation with this free
+    [[gnu::noinline]] void Release(void *p) noexcept { std::free(p); }
+}
+
+void *operator new(std::size_t size) { return CountedAllocation(size, 0); }
+void *operator new[](std::size_t size) { return CountedAllocation(size, 0); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return CountedAllocation(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return CountedAllocation(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept { Release(p); }
+void operator delete[](void *p) noexcept { Release(p); }
+void operator delete(void *p, std::size_t) noexcept { Release(p); }
+void operator delete[](void *p, std::size_t) noexcept { Release(p); }
+void operator delete(void *p, std::align_val_t) noexcept { Release(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { Release(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { Release(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { Release(p); }
+
+TEST(AllocationTests, RepeatedDaysDontAllocate) {
+    auto plan = sim::test::TestPlan();
+    sim::Simulator simulator(plan);
+    sim::Population reference(2000, 1, {0.5, 0.5});
+    simulator.InitializePopulation(reference, sim::data::ToSysDays(20));
+    simulator.SetProbabilities(1.5);
+
+    // The first pass grows every buffer to what these days need, after which simulating them again must reuse them
+    sim::Population pop(2000, 1, {0.5, 0.5});
+    for (int pass = 0; pass < 2; ++pass) {
+        pop.CopyFrom(reference);
+        auto before = allocations.load();
+        for (int day = 0; day < 5; ++day) {
+            simulator.ApplyVaccines(pop);
+            simulator.SimulateDay(pop);
+        }
+        ASSERT_GT(pop.InfectiousCount(), 0);
+        if (pass > 0) {
+            EXPECT_EQ(before, allocations.load());
+        }
+    }
+}
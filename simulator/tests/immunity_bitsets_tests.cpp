@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include "../sim/immunity_bitsets.hpp"
+#include "test_plan.hpp"
+
+TEST(ImmunityBitsetsTests, IncrementalUpdatesMatchDirectChecks) {
+    auto plan = sim::test::TestPlan({.population = 1000, .ages = {1.0}});
+    sim::Population pop(1000, 1, {1.0});
+    pop.Reset();
+    sim::ImmunityBitsets bits;
+    sim::Probabilities prob(3, 0, 0, 0);
+
+    for (pop.today = 0; pop.today < 60; ++pop.today) {
+        // Change the immunity of a few random people each day, reporting them as the simulator would
+        for (int k = 0; k < 15; ++k) {
+            auto i = static_cast<size_t>(prob.UniformScalar() * static_cast<double>(pop.people.size()));
+            for (size_t v = sim::kFirstVariant; v < sim::kVariantCount; ++v) {
+                const auto &info = *plan->variants[v];
+                auto scalar = (float)prob.UniformScalar();
+                if (k % 2) {
+                    pop.people.hot.natural_window[v][i] = info.NaturalImmunityWindow(scalar, pop.today);
+                } else {
+                    pop.people.hot.vaccine_window[v][i] = info.VaxImmunityWindow(scalar, pop.today);
+                }
+            }
+            bits.Touch(pop, i);
+        }
+
+        bits.Update(pop, *plan);
+        for (size_t v = sim::kFirstVariant; v < sim::kVariantCount; ++v) {
+            const auto &info = *plan->variants[v];
+            for (size_t i = 0; i < pop.people.size(); ++i) {
+                ASSERT_EQ(info.IsPersonNatImmune(pop.people, i, pop.today), bits.IsNatImmune(v, i))
+                    << "day " << pop.today << " person " << i;
+                ASSERT_EQ(info.IsPersonVaxImmune(pop.people, i, pop.today), bits.IsVaxImmune(v, i))
+                    << "day " << pop.today << " person " << i;
+            }
+        }
+    }
+}
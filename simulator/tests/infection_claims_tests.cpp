@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include "../sim/infection_claims.hpp"
+#include "../sim/thread_pool.hpp"
+
+TEST(InfectionClaimsTests, CollectsEachMemberOnceWithTheLowestVariant) {
+    const size_t size = 1000;
+    sim::InfectionClaims claims;
+    claims.Resize(size);
+    ASSERT_EQ((size + 63) / 64, claims.WordCount());
+
+    // Every third member is claimed by delta and every fifth by alpha, many times over and from several threads
+    auto alpha = sim::VariantIndex(sim::Variant::Alpha);
+    auto delta = sim::VariantIndex(sim::Variant::Delta);
+    sim::ThreadPool pool(4);
+    pool.ParallelFor(0, 40, 1, [&](size_t first, size_t last) {
+        for (auto repeat = first; repeat < last; ++repeat) {
+            for (size_t i = 0; i < size; ++i) {
+                if (i % 3 == 0) claims.Claim(delta, i);
+                if (i % 5 == 0) claims.Claim(alpha, i);
+            }
+        }
+    });
+
+    // Every variant's claims show through Claimed, which leaves them in place for Collect
+    for (size_t i = 0; i < 64; ++i) {
+        EXPECT_EQ(i % 3 == 0 || i % 5 == 0, ((claims.Claimed(0) >> i) & 1) != 0) << i;
+    }
+
+    std::vector<size_t> members;
+    for (size_t word = 0; word < claims.WordCount(); ++word) {
+        claims.Collect(word, [&](size_t index, size_t v) {
+            members.push_back(index);
+            EXPECT_EQ(index % 5 == 0 ? alpha : delta, v) << index;
+        });
+    }
+
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < size; ++i) {
+        if (i % 3 == 0 || i % 5 == 0) expected.push_back(i);
+    }
+    EXPECT_EQ(expected, members);
+
+    // Collecting clears the claims
+    for (size_t word = 0; word < claims.WordCount(); ++word) {
+        claims.Collect(word, [&](size_t index, size_t) { ADD_FAILURE() << index; });
+    }
+}
@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+#include "../sim/lanes.hpp"
+
+TEST(LanesTests, MasksFollowTheLanes) {
+    sim::Lanes<uint8_t> flags{0, 1, 0, 255, 7, 0, 0, 1};
+    EXPECT_EQ(0b10011010u, sim::NonZeroLanes(flags));
+    EXPECT_EQ(0u, sim::NonZeroLanes({}));
+
+    sim::Lanes<int32_t> days{-5, 0, 3, 4, 100, -32768, 32767, 4};
+    EXPECT_EQ(0b00100111u, sim::LanesBelow(days, 4));
+    EXPECT_EQ(sim::kAllLanes, sim::LanesBelow(days, 32768));
+    EXPECT_EQ(0u, sim::LanesBelow(days, -32768));
+
+    // Ranges include both ends, and a range ending before it starts holds nothing
+    sim::Lanes<int32_t> first{0, 5, 5, 6, -32768, 10, 3, 4};
+    sim::Lanes<int32_t> last{9, 5, 4, 9, 32767, 12, 5, 4};
+    EXPECT_EQ(0b01010011u, sim::LanesBetween(first, last, 5));
+    EXPECT_EQ(0b00110000u, sim::LanesBetween(first, last, 10));
+}
+
+TEST(LanesTests, CountsAddUpLaneByLane) {
+    sim::Lanes<int32_t> counts{1, 2, 3, 4, 5, 6, 7, 8};
+    sim::AddLanes(counts, {10, 0, -3, 0, 0, 0, 0, 100});
+    EXPECT_EQ((sim::Lanes<int32_t>{11, 2, 0, 4, 5, 6, 7, 108}), counts);
+
+    sim::CountLanes(counts, 0b10000011);
+    sim::CountLanes(counts, 0b00000001);
+    sim::CountLanes(counts, 0);
+    EXPECT_EQ((sim::Lanes<int32_t>{13, 3, 0, 4, 5, 6, 7, 109}), counts);
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "../sim/lockstep.hpp"
+#include "../sim/simulators.hpp"
+#include "test_plan.hpp"
+
+namespace {
+
+    void ExpectSameMember(const sim::Person &expected, const sim::Person &actual) {
+        EXPECT_EQ(expected.variant, actual.variant);
+        EXPECT_EQ(expected.infected_day, actual.infected_day);
+        EXPECT_EQ(expected.symptom_onset, actual.symptom_onset);
+        EXPECT_EQ(expected.vaccination_day, actual.vaccination_day);
+        EXPECT_EQ(expected.is_vaccinated, actual.is_vaccinated);
+        EXPECT_EQ(static_cast<float>(expected.natural_immunity_scalar),
+                  static_cast<float>(actual.natural_immunity_scalar));
+        EXPECT_EQ(static_cast<float>(expected.vaccine_immunity_scalar),
+                  static_cast<float>(actual.vaccine_immunity_scalar));
+    }
+
+    void ExpectSameSummary(const sim::DailySummary &expected, const sim::DailySummary &actual) {
+        EXPECT_EQ(expected.day, actual.day);
+        EXPECT_EQ(expected.total_infections, actual.total_infections);
+        EXPECT_EQ(expected.total_vaccinated, actual.total_vaccinated);
+        EXPECT_EQ(expected.never_infected, actual.never_infected);
+        EXPECT_EQ(expected.total_delta_infections, actual.total_delta_infections);
+        EXPECT_EQ(expected.total_alpha_infections, actual.total_alpha_infections);
+        EXPECT_EQ(expected.reinfections, actual.reinfections);
+        EXPECT_EQ(expected.vaccine_saves, actual.vaccine_saves);
+        EXPECT_EQ(expected.natural_saves, actual.natural_saves);
+        EXPECT_EQ(expected.vaccinated_infections, actual.vaccinated_infections);
+        EXPECT_EQ(expected.virus_carriers, actual.virus_carriers);
+
+        // Summed in another order
+        EXPECT_NEAR(expected.population_infectiousness, actual.population_infectiousness,
+                    1e-9 * expected.population_infectiousness);
+    }
+
+}
+
+TEST(LockstepTests, LanesMatchSeparateSimulators) {
+    // The small population ends up with most of its members in records, the large one with few of them. Curves with
+    // two peaks have no immunity windows, so records are screened against the curves instead.
+    const auto bimodal = sim::test::TestVariant({{0.0, 0.9, 0.3, 0.8, 0.2}, 1}, {{0.0, 0.6, 0.1, 0.7, 0.2}, 0});
+    for (int size : {2000, 40000}) {
+        for (size_t threads : {1, 3}) {
+            const bool windows = threads == 1;
+            auto plan = sim::test::TestPlan({.population = size,
+                                             .seed = 11,
+                                             .variant = windows ? sim::test::TestVariant() : bimodal,
+                                             .options = {.expensive_stats = true}});
+            ASSERT_EQ(windows, plan->variants[1]->HasNaturalWindows());
+            ASSERT_EQ(windows, plan->variants[1]->HasVaxWindows());
+            sim::Simulator simulator(plan, std::make_shared<sim::ThreadPool>(threads));
+            sim::Population reference(size, 1, {0.5, 0.5});
+            simulator.InitializePopulation(reference, sim::data::ToSysDays(20));
+
+            const std::vector<double> probabilities{0.6, 1.0, 1.5, 2.5, 4.0};
+            const uint32_t first_run = 4;
+            sim::LockstepSimulator lockstep(plan, simulator.Pool());
+            lockstep.Start(reference, probabilities, first_run);
+            ASSERT_EQ(probabilities.size(), lockstep.LaneCount());
+
+            // Lane l must give what a simulator with run first_run + l gives
+            std::vector<sim::Simulator> separate(probabilities.size(), simulator);
+            std::vector<sim::Population> pops(probabilities.size(), reference);
+            for (size_t l = 0; l < probabilities.size(); ++l) {
+                separate[l].SetProbabilities(probabilities[l]);
+                separate[l].SetRun(static_cast<int>(first_run + l));
+                pops[l].CopyFrom(reference);
+            }
+
+            std::array<sim::DailySummary, sim::LockstepSimulator::kLanes> summaries{};
+            for (int day = 0; day < 6; ++day) {
+                lockstep.ApplyVaccines();
+                lockstep.SimulateDay(summaries, true);
+
+                const auto &changes = lockstep.Changes();
+                for (size_t l = 0; l < probabilities.size(); ++l) {
+                    separate[l].ApplyVaccines(pops[l]);
+                    ExpectSameSummary(separate[l].SimulateDay(pops[l]), summaries[l]);
+
+                    const auto &pop = pops[l];
+                    ASSERT_EQ(pop.today, lockstep.Today());
+                    EXPECT_EQ(pop.TotalInfections(), lockstep.TotalInfections(l)) << size << " " << l << " " << day;
+                    EXPECT_EQ(pop.InfectiousCount(), lockstep.InfectiousCount(l)) << size << " " << l << " " << day;
+                    EXPECT_EQ(reference.never_infected - pop.never_infected, changes.first_infections[l]);
+                    EXPECT_EQ(pop.reinfections - reference.reinfections, changes.reinfections[l]);
+                    EXPECT_EQ(pop.vaccinated_infections - reference.vaccinated_infections,
+                              changes.vaccinated_infections[l]);
+                    EXPECT_EQ(pop.total_alpha_infections - reference.total_alpha_infections,
+                              changes.alpha_infections[l]);
+                    EXPECT_EQ(pop.total_delta_infections - reference.total_delta_infections,
+                              changes.delta_infections[l]);
+                    EXPECT_EQ(pop.natural_saves - reference.natural_saves, changes.natural_saves[l]);
+                    EXPECT_EQ(pop.vaccine_saves - reference.vaccine_saves, changes.vaccine_saves[l]);
+                    EXPECT_EQ(pop.total_vaccinated - reference.total_vaccinated, changes.vaccinations[l]);
+                }
+            }
+
+            for (size_t l = 0; l < probabilities.size(); ++l) {
+                for (size_t i = 0; i < static_cast<size_t>(size); ++i) {
+                    ASSERT_EQ(pops[l].IsInfectious(i), lockstep.IsInfectious(l, i)) << size << " " << l << " " << i;
+                    ExpectSameMember(pops[l].people[i], lockstep.Member(l, i));
+                }
+            }
+
+            // Lanes with more contacts infect more people
+            EXPECT_LT(lockstep.TotalInfections(0), lockstep.TotalInfections(probabilities.size() - 1));
+        }
+    }
+}
+
+TEST(LockstepTests, StartDiscardsThePreviousBatch) {
+    auto plan = sim::test::TestPlan({.population = 4000});
+    sim::Simulator simulator(plan, std::make_shared<sim::ThreadPool>(2));
+    sim::Population reference(4000, 1, {0.5, 0.5});
+    simulator.InitializePopulation(reference, sim::data::ToSysDays(20));
+
+    const std::vector<double> probabilities{0.8, 1.6, 3.2};
+    sim::LockstepSimulator lockstep(plan, simulator.Pool());
+    std::vector<int> first_totals;
+    for (int batch = 0; batch < 3; ++batch) {
+        // A batch of a different width in between must not leave anything behind either
+        std::span<const double> lanes(probabilities);
+        lockstep.Start(reference, batch == 1 ? lanes.first(1) : lanes, 9);
+        for (int day = 0; day < 4; ++day) {
+            lockstep.ApplyVaccines();
+            lockstep.SimulateDay();
+        }
+
+        if (batch == 1) continue;
+        std::vector<int> totals;
+        for (size_t l = 0; l < lockstep.LaneCount(); ++l) totals.push_back(lockstep.TotalInfections(l));
+        if (first_totals.empty()) {
+            first_totals = totals;
+        } else {
+            EXPECT_EQ(first_totals, totals);
+        }
+    }
+}
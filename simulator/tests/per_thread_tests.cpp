@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include "../sim/per_thread.hpp"
+
+namespace {
+    struct Counts {
+        long events{};
+        long odd{};
+
+        Counts &operator+=(const Counts &other) {
+            events += other.events;
+            odd += other.odd;
+            return *this;
+        }
+    };
+}
+
+TEST(PerThreadTests, SumCombinesEveryThread) {
+    sim::ThreadPool pool(4);
+    sim::PerThread<Counts> counts;
+    counts.Reset(pool);
+    ASSERT_EQ(4, counts.size());
+
+    // No two copies may share a cache line
+    for (size_t t = 1; t < counts.size(); ++t) {
+        auto distance = reinterpret_cast<uintptr_t>(&counts[t]) - reinterpret_cast<uintptr_t>(&counts[t - 1]);
+        EXPECT_GE(distance, sim::kCacheLine);
+    }
+
+    pool.ParallelFor(0, 100000, 100, [&](size_t first, size_t last) {
+        auto &local = counts.Local();
+        for (auto i = first; i < last; ++i) {
+            local.events++;
+            if (i % 2) local.odd++;
+        }
+    });
+
+    auto total = counts.Sum();
+    EXPECT_EQ(100000, total.events);
+    EXPECT_EQ(50000, total.odd);
+
+    counts.Reset(pool);
+    EXPECT_EQ(0, counts.Sum().events);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "../sim/plan.hpp"
+#include "test_plan.hpp"
+
+TEST(PlanTests, CompilesDenseHistories) {
+    sim::data::ProgramInput input{};
+    input.start_day = sim::data::ToSysDays(105);
+    input.end_day = sim::data::ToSysDays(110);
+    input.state = "XX";
+    input.population_scale = 10;
+    input.seed = 5;
+    input.world_properties = {sim::test::TestVariant(), sim::test::TestVariant()};
+    input.state_info["XX"] = {1000, {}, {1.0}};
+    for (int day = 100; day < 110; day += 2) {
+        input.infected_history["XX"][day] = {day * 10, 0};
+    }
+    input.vax_history["XX"][130] = {50};
+    input.variant_history["XX"] = {{104, {{"alpha", 1.0}}}, {200, {{"alpha", 0.25}, {"delta", 0.75}}}};
+
+    auto plan = sim::CompilePlan(input);
+    EXPECT_EQ(100, plan->history_first_day);
+    EXPECT_EQ(108, plan->history_last_day);
+
+    EXPECT_TRUE(plan->HasInfections(102));
+    EXPECT_FALSE(plan->HasInfections(103));
+    EXPECT_EQ(1080, plan->TotalInfections(108));
+    EXPECT_THROW((void)plan->TotalInfections(99), std::out_of_range);
+
+    EXPECT_EQ(50, plan->TotalCompletedVax(130));
+    EXPECT_EQ(sim::SimulationPlan::kNoRecord, plan->TotalCompletedVax(129));
+    EXPECT_EQ(sim::SimulationPlan::kNoRecord, plan->TotalCompletedVax(10000));
+
+    const auto &early = plan->VariantFractionsOn(104);
+    EXPECT_DOUBLE_EQ(1.0, early[sim::VariantIndex(sim::Variant::Alpha)]);
+    EXPECT_DOUBLE_EQ(0.0, early[sim::VariantIndex(sim::Variant::Delta)]);
+    const auto &late = plan->VariantFractionsOn(105);
+    EXPECT_DOUBLE_EQ(0.75, late[sim::VariantIndex(sim::Variant::Delta)]);
+
+    EXPECT_EQ(sim::Variant::Delta, plan->VariantInfo(sim::Variant::Delta).GetVariant());
+    EXPECT_DOUBLE_EQ(0.3, plan->VariantInfo(sim::Variant::Alpha).GetInfectivity(0));
+}
+
+TEST(PlanTests, RejectsDaysOutsideTheStoredRange) {
+    if (sizeof(sim::StoredDay) == sizeof(int)) GTEST_SKIP() << "Days are stored at full width in this build";
+
+    sim::data::ProgramInput input{};
+    input.start_day = sim::data::ToSysDays(sim::kMaxStoredDay - 100);
+    input.end_day = sim::data::ToSysDays(sim::kMaxStoredDay - 10);
+    input.state = "XX";
+    input.population_scale = 10;
+    input.world_properties = {sim::test::TestVariant(), sim::test::TestVariant()};
+    input.state_info["XX"] = {1000, {}, {1.0}};
+    input.infected_history["XX"][sim::kMaxStoredDay - 100] = {10, 0};
+    EXPECT_THROW((void)sim::CompilePlan(input), std::out_of_range);
+
+    input.start_day = sim::data::ToSysDays(100);
+    input.end_day = sim::data::ToSysDays(110);
+    input.infected_history["XX"] = {{100, {10, 0}}};
+    EXPECT_NO_THROW((void)sim::CompilePlan(input));
+}
@@ -6,45 +6,179 @@
 TEST(PopulationTests, InfectiousStressTests) {
     std::mt19937_64 generator{std::random_device{}()};
 
-    sim::Population pop(1000, 1);
+    sim::Population pop(1000, 1, {1.0});
+    std::uniform_int_distribution<size_t> select_any(0, pop.people.size() - 1);
     int iterations = 0;
     int infectious = 0;
     while (++iterations < 10000) {
 
         // Add a random number of infectious people
-        auto not_infectious = pop.people.size() - pop.EndOfInfectious();
+        auto not_infectious = pop.people.size() - pop.InfectiousCount();
         std::uniform_int_distribution<size_t> dist_infect(0, (size_t)std::min((int)not_infectious, 100));
         auto to_infect = dist_infect(generator);
         for (size_t i = 0; i < to_infect; ++i) {
-            std::uniform_int_distribution<size_t> select(pop.EndOfInfectious(), pop.people.size());
-            auto index = select(generator);
+            auto index = select_any(generator);
+            while (pop.IsInfectious(index)) index = select_any(generator);
             infectious++;
             pop.people[index].variant = sim::Variant::Alpha;
             pop.AddToInfected(index);
         }
 
         // Remove a random number of infectious people
-        std::uniform_int_distribution<size_t> dist_rmv(0, (size_t)std::min((int)pop.EndOfInfectious(), 100));
+        std::uniform_int_distribution<size_t> dist_rmv(0, (size_t)std::min((int)pop.InfectiousCount(), 100));
         auto to_disinfect = dist_rmv(generator);
         for (size_t i = 0; i < to_disinfect; ++i) {
-            std::uniform_int_distribution<size_t> select(0, pop.EndOfInfectious() - 1);
-            auto index = select(generator);
+            std::uniform_int_distribution<size_t> select(0, pop.InfectiousCount() - 1);
+            auto index = pop.Infectious()[select(generator)];
             infectious--;
             pop.people[index].variant = sim::Variant::None;
             pop.RemoveFromInfected(index);
         }
 
-        // Verify that only infectious people are at a position less than the pointer end
-        for (size_t i = 0; i < pop.EndOfInfectious(); ++i) {
-            EXPECT_EQ(sim::Variant::Alpha, pop.people[i].variant);
+        // Verify that exactly the infectious people are in the set, and that each knows its position in the list
+        for (size_t i = 0; i < pop.people.size(); ++i) {
+            EXPECT_EQ(pop.people[i].variant == sim::Variant::Alpha, pop.IsInfectious(i));
         }
-
-        // Verify that only non-infectious people are at a position greater or equal to the pointer end
-        for (size_t i = pop.EndOfInfectious(); i < pop.people.size(); ++i) {
-            EXPECT_EQ(sim::Variant::None, pop.people[i].variant);
+        for (size_t k = 0; k < pop.InfectiousCount(); ++k) {
+            EXPECT_EQ(k, pop.people.hot.infectious_slot[pop.Infectious()[k]]);
         }
 
         // Verify that the count of infectious people matches expectations
         EXPECT_EQ(infectious, pop.CurrentlyInfectious());
     }
 }
+
+TEST(PopulationTests, ColumnarView) {
+    sim::Population pop(100, 1, {0.5, 0.5});
+    ASSERT_EQ(100, pop.people.size());
+    EXPECT_EQ(0, pop.people[0].age);
+    EXPECT_EQ(1, pop.people[99].age);
+
+    // Writes through the mutable view land in the columns
+    auto person = pop.people[99];
+    person.variant = sim::Variant::Delta;
+    person.infected_day = 12;
+    person.natural_immunity_scalar = 0.25f;
+    person.is_vaccinated = true;
+    EXPECT_EQ(sim::Variant::Delta, pop.people.hot.variant[99]);
+    EXPECT_EQ(12, pop.people.hot.infected_day[99]);
+
+    // Joining the infectious set leaves the record where it was
+    pop.AddToInfected(99);
+    const auto &const_pop = pop;
+    sim::Person same = const_pop.people[99];
+    EXPECT_EQ(sim::Variant::Delta, same.variant);
+    EXPECT_EQ(12, same.infected_day);
+    EXPECT_FLOAT_EQ(sim::StoredScalar(0.25f), same.natural_immunity_scalar);
+    EXPECT_TRUE(same.is_vaccinated);
+    EXPECT_EQ(1, same.age);
+    EXPECT_EQ(0, pop.people[0].age);
+    EXPECT_FALSE(pop.people[0].IsInfected());
+    ASSERT_EQ(1, pop.InfectiousCount());
+    EXPECT_EQ(99, pop.Infectious()[0]);
+}
+
+TEST(PopulationTests, QuantizedScalarsRoundTrip) {
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+    for (int i = 0; i < 10000; ++i) {
+        float value = dist(gen);
+        sim::QuantizedScalar stored = value;
+        EXPECT_NEAR(value, stored, 0.5f / sim::QuantizedScalar::kSteps);
+
+        // Storing a value that was read back doesn't move it again
+        sim::QuantizedScalar again = static_cast<float>(stored);
+        EXPECT_EQ(static_cast<float>(stored), static_cast<float>(again));
+    }
+
+    EXPECT_EQ(0.f, static_cast<float>(sim::QuantizedScalar(-0.5f)));
+    EXPECT_EQ(1.f, static_cast<float>(sim::QuantizedScalar(1.f)));
+}
+
+TEST(PopulationTests, BytesPerRecordCoversEveryColumn) {
+    sim::Population pop(1000, 1, {1.0});
+    size_t bytes = 0;
+    pop.people.ForEachColumn([&](const auto &values) { bytes += values.size() * sizeof(values[0]); });
+    EXPECT_EQ(pop.people.size() * sim::People::kBytesPerRecord, bytes);
+}
+
+TEST(PopulationTests, CopyFromRestoresDirtyMembers) {
+    sim::Population reference(1000, 1, {0.5, 0.5});
+    reference.Reset();
+    reference.people[10].variant = sim::Variant::Alpha;
+    reference.MarkDirty(10);
+    reference.AddToInfected(10);
+
+    auto expect_same = [&](const sim::Population &pop) {
+        ASSERT_EQ(reference.Infectious(), pop.Infectious());
+        for (size_t i = 0; i < pop.people.size(); ++i) {
+            ASSERT_EQ(reference.IsInfectious(i), pop.IsInfectious(i)) << i;
+            ASSERT_EQ(reference.people.hot.variant[i], pop.people.hot.variant[i]) << i;
+            ASSERT_EQ(reference.people.hot.infected_day[i], pop.people.hot.infected_day[i]) << i;
+            ASSERT_EQ(reference.people.Age(i), pop.people.Age(i)) << i;
+        }
+    };
+
+    sim::Population working(1000, 1, {0.5, 0.5});
+    for (int round = 0; round < 3; ++round) {
+        working.CopyFrom(reference);
+        expect_same(working);
+
+        // A few modifications are restored from the dirty list, later rounds overflow it and force a full copy
+        for (size_t i = 0; i < static_cast<size_t>(20 * (round * round + 1)); ++i) {
+            size_t index = (i * 37 + 500) % working.people.size();
+            working.people[index].infected_day = round + 1;
+            working.MarkDirty(index);
+            working.AddToInfected(index);
+        }
+    }
+
+    // Modifying the source invalidates the dirty list
+    working.CopyFrom(reference);
+    working.people[900].variant = sim::Variant::Delta;
+    working.MarkDirty(900);
+    reference.people[800].variant = sim::Variant::Delta;
+    reference.MarkDirty(800);
+    working.CopyFrom(reference);
+    expect_same(working);
+
+    // Only populations of the same size can be copied
+    sim::Population smaller(900, 1, {0.5, 0.5});
+    EXPECT_THROW(smaller.CopyFrom(reference), std::invalid_argument);
+}
+
+TEST(PopulationTests, RecoveryWheelDrainsOnTheScheduledDay) {
+    std::mt19937_64 generator{17};
+    sim::Population pop(2000, 1, {1.0});
+    pop.Reset();
+    pop.today = 100;
+
+    // Remember the day each carrier should recover
+    std::vector<int> recovery(pop.people.size(), 0);
+
+    std::uniform_int_distribution<int> delay(1, 40);
+    std::uniform_int_distribution<size_t> select(0, pop.people.size() - 1);
+    for (; pop.today < 200; ++pop.today) {
+        // Everyone due today is removed, and nobody else
+        std::vector<size_t> removed;
+        pop.DrainRecoveries([&](size_t index) { removed.push_back(index); });
+        for (auto index : removed) {
+            EXPECT_EQ(pop.today, recovery[index]);
+            EXPECT_FALSE(pop.IsInfectious(index));
+            recovery[index] = 0;
+        }
+        for (auto index : pop.Infectious()) {
+            ASSERT_GT(recovery[index], pop.today);
+        }
+
+        // Infect some more, some of them far enough out to make the wheel grow
+        for (int k = 0; k < 15 && pop.InfectiousCount() < pop.people.size(); ++k) {
+            auto index = select(generator);
+            if (pop.IsInfectious(index)) continue;
+            auto day = pop.today + (pop.today == 150 ? 90 : delay(generator));
+            recovery[index] = day;
+            pop.ScheduleRecovery(index, day);
+            pop.AddToInfected(index);
+        }
+    }
+}
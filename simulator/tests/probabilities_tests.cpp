@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "../sim/probabilities.hpp"
+
+TEST(ProbabilitiesTests, PhiloxKnownAnswer) {
+    // Known answer vectors from the Random123 distribution (kat_vectors, philox4x32 with 10 rounds)
+    auto zero = sim::Philox4x32::Block({0, 0}, {0, 0, 0, 0});
+    EXPECT_EQ(0x6627e8d5u, zero[0]);
+    EXPECT_EQ(0xe169c58du, zero[1]);
+    EXPECT_EQ(0xbc57ac4cu, zero[2]);
+    EXPECT_EQ(0x9b00dbd8u, zero[3]);
+
+    auto ones = sim::Philox4x32::Block({0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff});
+    EXPECT_EQ(0x408f276du, ones[0]);
+    EXPECT_EQ(0x41c83b0eu, ones[1]);
+    EXPECT_EQ(0xa20bc7c6u, ones[2]);
+    EXPECT_EQ(0x6d5451fdu, ones[3]);
+}
+
+TEST(ProbabilitiesTests, StreamsAreReproducibleAndDistinct) {
+    sim::Probabilities a(42, 1, 900, 17);
+    sim::Probabilities b(42, 1, 900, 17);
+    sim::Probabilities other_stream(42, 1, 900, 18);
+    sim::Probabilities other_day(42, 1, 901, 17);
+
+    int matches_stream = 0;
+    int matches_day = 0;
+    for (int i = 0; i < 1000; ++i) {
+        auto x = a.UniformScalar();
+        EXPECT_EQ(x, b.UniformScalar());
+        EXPECT_GE(x, 0.0);
+        EXPECT_LT(x, 1.0);
+        matches_stream += x == other_stream.UniformScalar();
+        matches_day += x == other_day.UniformScalar();
+    }
+    EXPECT_EQ(0, matches_stream);
+    EXPECT_EQ(0, matches_day);
+}
+
+TEST(ProbabilitiesTests, UniformScalarMean) {
+    sim::Probabilities prob(7, 0, 0, 0);
+    double sum = 0;
+    const int n = 200000;
+    for (int i = 0; i < n; ++i) sum += prob.UniformScalar();
+    EXPECT_NEAR(0.5, sum / n, 0.005);
+}
+
+TEST(ProbabilitiesTests, UniformPairAtMatchesSequentialDraws) {
+    sim::Probabilities prob(42, 3, 900, sim::RandomStream::Infection);
+    for (uint32_t position = 0; position < 100; ++position) {
+        auto pair = sim::Probabilities::UniformPairAt(42, 3, 900, sim::RandomStream::Infection, position);
+        EXPECT_EQ(prob.UniformScalar(), pair[0]);
+        EXPECT_EQ(prob.UniformScalar(), pair[1]);
+    }
+}
+
+TEST(ProbabilitiesTests, ParallelBlocksMatchBlock) {
+    std::mt19937 gen(5);
+    for (int trial = 0; trial < 100; ++trial) {
+        std::array<uint32_t, 2> key{static_cast<uint32_t>(gen()), static_cast<uint32_t>(gen())};
+        sim::Philox4x32::CounterWords words;
+        for (auto &word : words) {
+            for (auto &value : word) value = static_cast<uint32_t>(gen());
+        }
+
+        auto blocks = words;
+        sim::Philox4x32::Blocks(key, blocks);
+        for (size_t i = 0; i < sim::Philox4x32::kParallelBlocks; ++i) {
+            auto expected = sim::Philox4x32::Block(key, {words[0][i], words[1][i], words[2][i], words[3][i]});
+            for (size_t w = 0; w < 4; ++w) {
+                ASSERT_EQ(expected[w], blocks[w][i]) << trial << " " << i << " " << w;
+            }
+        }
+    }
+}
+
+TEST(ProbabilitiesTests, StreamFromFirstBlockMatchesStream) {
+    const uint64_t seed = 0x1234567890abcdefull;
+    auto first_block = sim::Philox4x32::Block({static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+                                              {0, 3, 900, 17});
+    sim::Probabilities expected(seed, 3, 900, 17);
+    sim::Probabilities resumed(seed, 3, 900, 17, first_block);
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(expected.UniformScalar(), resumed.UniformScalar()) << i;
+    }
+}
+
+TEST(ProbabilitiesTests, UniformPairsAtMatchUniformPairAt) {
+    std::array<uint32_t, sim::Philox4x32::kParallelBlocks> runs{};
+    std::array<uint32_t, sim::Philox4x32::kParallelBlocks> positions{};
+    for (uint32_t i = 0; i < runs.size(); ++i) {
+        runs[i] = i % 3;
+        positions[i] = 1000 + 7 * i;
+    }
+
+    auto pairs = sim::Probabilities::UniformPairsAt(42, runs, 900, sim::RandomStream::Infection, positions);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        auto expected = sim::Probabilities::UniformPairAt(42, runs[i], 900, sim::RandomStream::Infection, positions[i]);
+        EXPECT_EQ(expected[0], pairs[i][0]) << i;
+        EXPECT_EQ(expected[1], pairs[i][1]) << i;
+    }
+}
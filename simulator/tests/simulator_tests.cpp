@@ -0,0 +1,271 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <utility>
+#include "../sim/simulators.hpp"
+#include "test_plan.hpp"
+
+TEST(SimulatorTests, AdvancingMatchesInitializingFromScratch) {
+    auto plan = sim::test::TestPlan();
+    sim::Simulator simulator(plan);
+    sim::Population advanced(2000, 1, {0.5, 0.5});
+    simulator.InitializePopulation(advanced, sim::data::ToSysDays(5));
+
+    for (int day : {12, 13, 25, 35}) {
+        simulator.AdvancePopulation(advanced, sim::data::ToSysDays(day));
+
+        sim::Population fresh(2000, 1, {0.5, 0.5});
+        simulator.InitializePopulation(fresh, sim::data::ToSysDays(day));
+
+        ASSERT_EQ(fresh.today, advanced.today);
+        ASSERT_EQ(fresh.TotalInfections(), advanced.TotalInfections());
+        ASSERT_EQ(fresh.TotalVaccinated(), advanced.TotalVaccinated());
+        ASSERT_EQ(fresh.Infectious(), advanced.Infectious());
+        for (size_t i = 0; i < fresh.people.size(); ++i) {
+            ASSERT_EQ(fresh.people.hot.variant[i], advanced.people.hot.variant[i]) << day << " " << i;
+            ASSERT_EQ(fresh.people.hot.infected_day[i], advanced.people.hot.infected_day[i]) << day << " " << i;
+            ASSERT_EQ(fresh.people.hot.vaccination_day[i], advanced.people.hot.vaccination_day[i]) << day << " " << i;
+        }
+    }
+}
+
+TEST(SimulatorTests, AggregateEngineMatchesPerCarrierStatistically) {
+    // Both engines simulate the same day from the same population many times, and the mean outcomes must agree to
+    // within sampling error
+    constexpr int kRuns = 400;
+    struct Moments {
+        double sum{};
+        double sum_sq{};
+        void Add(double x) { sum += x; sum_sq += x * x; }
+        [[nodiscard]] double Mean() const { return sum / kRuns; }
+        [[nodiscard]] double MeanVariance() const { return (sum_sq / kRuns - Mean() * Mean()) / kRuns; }
+    };
+
+    auto sample = [&](sim::data::InfectionEngine engine, Moments &infections, Moments &natural_saves) {
+        auto plan = sim::test::TestPlan({.population = 20000, .options = {.engine = engine}});
+        sim::Simulator simulator(plan);
+        sim::Population reference(20000, 1, {0.5, 0.5});
+        simulator.InitializePopulation(reference, sim::data::ToSysDays(25));
+        sim::Population working = reference;
+        simulator.SetProbabilities(2.0);
+
+        for (int run = 0; run < kRuns; ++run) {
+            working.CopyFrom(reference);
+            simulator.SetRun(run);
+            simulator.SimulateDay(working);
+            infections.Add(working.TotalInfections() - reference.TotalInfections());
+            natural_saves.Add(working.NaturalSaves());
+        }
+    };
+
+    Moments carrier_infections, carrier_saves, aggregate_infections, aggregate_saves;
+    sample(sim::data::InfectionEngine::PerCarrier, carrier_infections, carrier_saves);
+    sample(sim::data::InfectionEngine::Aggregate, aggregate_infections, aggregate_saves);
+
+    ASSERT_GT(carrier_infections.Mean(), 20);
+    ASSERT_GT(carrier_saves.Mean(), 1);
+    EXPECT_LT(std::abs(carrier_infections.Mean() - aggregate_infections.Mean()),
+              4 * std::sqrt(carrier_infections.MeanVariance() + aggregate_infections.MeanVariance()));
+    EXPECT_LT(std::abs(carrier_saves.Mean() - aggregate_saves.Mean()),
+              4 * std::sqrt(carrier_saves.MeanVariance() + aggregate_saves.MeanVariance()));
+}
+
+TEST(SimulatorTests, CarriersLeaveOnTheFirstDayWithoutInfectivity) {
+    auto plan = sim::test::TestPlan();
+    sim::Simulator simulator(plan);
+    sim::Population pop(2000, 1, {0.5, 0.5});
+    simulator.InitializePopulation(pop, sim::data::ToSysDays(20));
+    simulator.SetProbabilities(1.5);
+
+    // Nobody still in the infectious set may have reached a day after onset without infectivity, and everyone who
+    // left it must have
+    auto still_infectious = [&](size_t i, int through_day) {
+        const auto &info = plan->VariantInfo(pop.people.hot.variant[i]);
+        for (int day = pop.people.hot.symptom_onset[i] + 1; day <= through_day; ++day) {
+            if (info.GetInfectivity(day - pop.people.hot.symptom_onset[i]) <= 0) return false;
+        }
+        return true;
+    };
+
+    for (int step = 0; step < 10; ++step) {
+        simulator.ApplyVaccines(pop);
+        simulator.SimulateDay(pop);
+        int simulated = pop.today - 1;
+        ASSERT_GT(pop.InfectiousCount(), 0);
+        for (size_t i = 0; i < pop.people.size(); ++i) {
+            if (pop.people.hot.variant[i] == sim::Variant::None) continue;
+            ASSERT_EQ(pop.IsInfectious(i), still_infectious(i, simulated)) << step << " " << i;
+        }
+    }
+}
+
+TEST(SimulatorTests, PrefetchBatchDoesNotChangeResults) {
+    for (auto engine : {sim::data::InfectionEngine::PerCarrier, sim::data::InfectionEngine::Aggregate}) {
+        auto plan = sim::test::TestPlan({.options = {.engine = engine}});
+        sim::Simulator reference_simulator(plan);
+        sim::Population reference(2000, 1, {0.5, 0.5});
+        reference_simulator.InitializePopulation(reference, sim::data::ToSysDays(20));
+
+        std::vector<std::vector<sim::DailySummary>> outcomes;
+        for (int batch : {1, 7, 256}) {
+            sim::Simulator simulator(plan);
+            simulator.SetProbabilities(1.5);
+            simulator.SetPrefetchBatch(batch);
+            sim::Population pop(2000, 1, {0.5, 0.5});
+            pop.CopyFrom(reference);
+
+            outcomes.emplace_back();
+            for (int day = 0; day < 8; ++day) {
+                simulator.ApplyVaccines(pop);
+                outcomes.back().push_back(simulator.SimulateDay(pop));
+            }
+        }
+
+        for (size_t k = 1; k < outcomes.size(); ++k) {
+            for (size_t day = 0; day < outcomes[0].size(); ++day) {
+                EXPECT_EQ(outcomes[0][day].total_infections, outcomes[k][day].total_infections);
+                EXPECT_EQ(outcomes[0][day].natural_saves, outcomes[k][day].natural_saves);
+                EXPECT_EQ(outcomes[0][day].vaccine_saves, outcomes[k][day].vaccine_saves);
+                EXPECT_EQ(outcomes[0][day].virus_carriers, outcomes[k][day].virus_carriers);
+            }
+        }
+    }
+}
+
+TEST(SimulatorTests, ThreadCountDoesNotChangeResults) {
+    const int size = 100000;
+    auto plan = sim::test::TestPlan({.population = size});
+    sim::Simulator reference_simulator(plan, std::make_shared<sim::ThreadPool>(1));
+    sim::Population reference(size, 1, {0.5, 0.5});
+    reference_simulator.InitializePopulation(reference, sim::data::ToSysDays(20));
+    ASSERT_GT(reference.InfectiousCount(), 1000);
+
+    std::vector<std::vector<sim::DailySummary>> outcomes;
+    for (size_t threads : {1, 3}) {
+        sim::Simulator simulator(plan, std::make_shared<sim::ThreadPool>(threads));
+        simulator.SetProbabilities(1.5);
+        sim::Population pop(size, 1, {0.5, 0.5});
+        pop.CopyFrom(reference);
+
+        outcomes.emplace_back();
+        for (int day = 0; day < 8; ++day) {
+            simulator.ApplyVaccines(pop);
+            outcomes.back().push_back(simulator.SimulateDay(pop));
+        }
+    }
+
+    for (size_t day = 0; day < outcomes[0].size(); ++day) {
+        EXPECT_EQ(outcomes[0][day].total_infections, outcomes[1][day].total_infections);
+        EXPECT_EQ(outcomes[0][day].natural_saves, outcomes[1][day].natural_saves);
+        EXPECT_EQ(outcomes[0][day].vaccine_saves, outcomes[1][day].vaccine_saves);
+        EXPECT_EQ(outcomes[0][day].virus_carriers, outcomes[1][day].virus_carriers);
+    }
+}
+
+TEST(SimulatorTests, SerialThresholdChoosesTheScheduleNotTheResults) {
+    const int size = 100000;
+    std::vector<std::vector<sim::DailySummary>> outcomes;
+    for (int threshold : {0, size}) {
+        auto plan = sim::test::TestPlan({.population = size, .options = {.serial_threshold = threshold}});
+        sim::Simulator simulator(plan, std::make_shared<sim::ThreadPool>(3));
+        EXPECT_EQ(threshold, simulator.SerialThreshold());
+
+        sim::Population pop(size, 1, {0.5, 0.5});
+        simulator.InitializePopulation(pop, sim::data::ToSysDays(20));
+        simulator.SetProbabilities(1.5);
+        outcomes.emplace_back();
+        for (int day = 0; day < 8; ++day) {
+            simulator.ApplyVaccines(pop);
+            outcomes.back().push_back(simulator.SimulateDay(pop));
+        }
+
+        // Every day has at least one carrier and fewer than the whole population
+        const auto &schedule = simulator.Schedule();
+        EXPECT_EQ(threshold == 0 ? 0 : schedule.serial_days + schedule.parallel_days, schedule.serial_days);
+    }
+
+    for (size_t day = 0; day < outcomes[0].size(); ++day) {
+        EXPECT_EQ(outcomes[0][day].total_infections, outcomes[1][day].total_infections);
+        EXPECT_EQ(outcomes[0][day].virus_carriers, outcomes[1][day].virus_carriers);
+    }
+}
+
+TEST(SimulatorTests, SparseStorageDoesNotChangeResults) {
+    const int size = 20000;
+    for (bool bitsets : {false, true}) {
+        auto plan = sim::test::TestPlan({.population = size, .options = {.immunity_bitsets = bitsets}});
+        sim::Simulator simulator(plan, std::make_shared<sim::ThreadPool>(3));
+        simulator.SetProbabilities(1.5);
+
+        std::vector<sim::Population> references;
+        std::vector<sim::Population> pops;
+        for (bool sparse : {false, true}) {
+            references.emplace_back(size, 1, std::vector<double>{0.5, 0.5}, sparse);
+            simulator.InitializePopulation(references.back(), sim::data::ToSysDays(20));
+            pops.emplace_back(size, 1, std::vector<double>{0.5, 0.5}, sparse);
+        }
+
+        // Only the members who were touched have a record of their own
+        const auto &sparse_people = references[1].people;
+        EXPECT_LT(sparse_people.SlotCount(), size / 2);
+        for (size_t i = 0; i < sparse_people.size(); ++i) {
+            bool touched = sparse_people.hot.variant[sparse_people.Slot(i)] != sim::Variant::None ||
+                           sparse_people.hot.is_vaccinated[sparse_people.Slot(i)];
+            ASSERT_EQ(touched, sparse_people.Slot(i) != sim::SlotTable::kNoSlot) << i;
+        }
+
+        // The second run restores the populations from the members modified in the first
+        for (uint32_t run = 0; run < 2; ++run) {
+            std::vector<std::vector<sim::DailySummary>> outcomes(2);
+            for (size_t k = 0; k < 2; ++k) {
+                pops[k].CopyFrom(references[k]);
+                simulator.SetRun(run);
+                for (int day = 0; day < 8; ++day) {
+                    simulator.ApplyVaccines(pops[k]);
+                    outcomes[k].push_back(simulator.SimulateDay(pops[k]));
+                }
+            }
+
+            for (size_t day = 0; day < outcomes[0].size(); ++day) {
+                EXPECT_EQ(outcomes[0][day].total_infections, outcomes[1][day].total_infections);
+                EXPECT_EQ(outcomes[0][day].natural_saves, outcomes[1][day].natural_saves);
+                EXPECT_EQ(outcomes[0][day].vaccine_saves, outcomes[1][day].vaccine_saves);
+                EXPECT_EQ(outcomes[0][day].virus_carriers, outcomes[1][day].virus_carriers);
+            }
+            EXPECT_EQ(pops[0].Infectious(), pops[1].Infectious());
+            for (size_t i = 0; i < size; ++i) {
+                ASSERT_EQ(std::as_const(pops[0]).people[i].symptom_onset, std::as_const(pops[1]).people[i].symptom_onset);
+            }
+        }
+    }
+}
+
+TEST(SimulatorTests, SparseCopiesKeepOnlyTheReferenceSlots) {
+    const int size = 80000;
+    auto plan = sim::test::TestPlan({.population = size});
+    sim::Simulator simulator(plan, std::make_shared<sim::ThreadPool>(2));
+    simulator.SetProbabilities(1.5);
+    sim::Population reference(size, 1, {0.5, 0.5}, true);
+    simulator.InitializePopulation(reference, sim::data::ToSysDays(12));
+    sim::Population pop(size, 1, {0.5, 0.5}, true);
+
+    // Members touched by one run but not by the reference must not keep a slot into the next runs
+    for (int run = 0; run < 6; ++run) {
+        pop.CopyFrom(reference);
+        ASSERT_EQ(reference.people.SlotCount(), pop.people.SlotCount()) << run;
+        for (size_t i = 0; i < pop.people.size(); ++i) {
+            ASSERT_EQ(reference.people.Slot(i) == sim::SlotTable::kNoSlot,
+                      pop.people.Slot(i) == sim::SlotTable::kNoSlot) << run << " " << i;
+            ASSERT_EQ(std::as_const(reference).people[i].symptom_onset, std::as_const(pop).people[i].symptom_onset);
+        }
+
+        simulator.SetRun(run);
+        for (int day = 0; day < 3; ++day) {
+            simulator.ApplyVaccines(pop);
+            simulator.SimulateDay(pop);
+        }
+        // The run modified few enough members to keep track of them, so the next copy restores just those
+        const auto *modified = pop.ModifiedSinceCopy(reference);
+        ASSERT_NE(nullptr, modified);
+        EXPECT_LE(pop.people.SlotCount(), reference.people.SlotCount() + modified->size());
+    }
+}
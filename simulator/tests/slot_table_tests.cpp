@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <unordered_map>
+#include "../sim/population/slot_table.hpp"
+
+TEST(SlotTableTests, FindsEveryInsertedMember) {
+    sim::SlotTable table;
+    EXPECT_EQ(sim::SlotTable::kNoSlot, table.Find(5));
+
+    // Members are inserted in a random order so that they collide and grow the table several times
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<uint32_t> dist(0, 1000000);
+    std::unordered_map<size_t, uint32_t> expected;
+    for (uint32_t slot = 1; expected.size() < 5000; ++slot) {
+        auto index = dist(gen);
+        if (expected.count(index)) continue;
+        expected[index] = slot;
+        table.Insert(index, slot);
+    }
+
+    EXPECT_EQ(expected.size(), table.size());
+    for (const auto &[index, slot] : expected) {
+        ASSERT_EQ(slot, table.Find(index)) << index;
+    }
+    for (size_t index = 0; index < 20000; ++index) {
+        if (!expected.count(index)) {
+            ASSERT_EQ(sim::SlotTable::kNoSlot, table.Find(index)) << index;
+        }
+    }
+
+    table.Clear();
+    EXPECT_EQ(0, table.size());
+    EXPECT_EQ(sim::SlotTable::kNoSlot, table.Find(expected.begin()->first));
+}
+
+TEST(SlotTableTests, ErasedMembersLeaveTheOthersFindable) {
+    sim::SlotTable table;
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<uint32_t> dist(0, 100000);
+    std::unordered_map<size_t, uint32_t> expected;
+    for (uint32_t slot = 1; expected.size() < 3000; ++slot) {
+        auto index = dist(gen);
+        if (expected.count(index)) continue;
+        expected[index] = slot;
+        table.Insert(index, slot);
+    }
+
+    // Erasing every other member in the table's own order breaks up plenty of probe runs
+    std::vector<size_t> erased;
+    for (const auto &[index, slot] : expected) {
+        if (erased.size() * 2 < expected.size() && gen() % 2) erased.push_back(index);
+    }
+    for (auto index : erased) {
+        table.Erase(index);
+        expected.erase(index);
+    }
+    for (auto &[index, slot] : expected) {
+        slot += 100000;
+        table.Update(index, slot);
+    }
+
+    EXPECT_EQ(expected.size(), table.size());
+    for (const auto &[index, slot] : expected) {
+        ASSERT_EQ(slot, table.Find(index)) << index;
+    }
+    for (auto index : erased) {
+        ASSERT_EQ(sim::SlotTable::kNoSlot, table.Find(index)) << index;
+    }
+}
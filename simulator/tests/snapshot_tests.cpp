@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../sim/snapshot.hpp"
+#include "../sim/simulators.hpp"
+#include "test_plan.hpp"
+
+namespace {
+    // A short history which keeps the summary of every day
+    const sim::test::TestPlanOptions kSnapshotPlan{.population = 1000, .end_day = 12, .options = {.full_history = true}};
+}
+
+TEST(SnapshotTests, SavedPopulationLoadsIdentically) {
+    for (bool sparse : {false, true}) {
+        auto input = sim::test::TestInput(kSnapshotPlan);
+        input.options.sparse_population = sparse;
+        auto plan = sim::CompilePlan(input);
+        sim::Simulator simulator(plan);
+        sim::Population original(1000, 1, {0.5, 0.5}, sparse);
+        auto summaries = simulator.InitializePopulation(original, sim::data::ToSysDays(10));
+        ASSERT_GT(original.InfectiousCount(), 0);
+
+        auto key = sim::PopulationSnapshot::Key(*plan, 10);
+        auto file_name = (std::filesystem::temp_directory_path() / "delta_sim_snapshot_test.bin").string();
+        ASSERT_TRUE(sim::PopulationSnapshot::Save(file_name, key, original, summaries));
+
+        // A snapshot only loads into a population with the same storage
+        sim::Population other_storage(1000, 1, {0.5, 0.5}, !sparse);
+        sim::Population loaded(1000, 1, {0.5, 0.5}, sparse);
+        std::vector<sim::DailySummary> loaded_summaries;
+        EXPECT_FALSE(sim::PopulationSnapshot::Load(file_name, key + 1, loaded, loaded_summaries));
+        EXPECT_FALSE(sim::PopulationSnapshot::Load(file_name, key, other_storage, loaded_summaries));
+        ASSERT_TRUE(sim::PopulationSnapshot::Load(file_name, key, loaded, loaded_summaries));
+        std::filesystem::remove(file_name);
+
+        EXPECT_EQ(original.today, loaded.today);
+        EXPECT_EQ(original.Infectious(), loaded.Infectious());
+        EXPECT_EQ(original.TotalInfections(), loaded.TotalInfections());
+        EXPECT_EQ(original.NeverInfected(), loaded.NeverInfected());
+        ASSERT_EQ(summaries.size(), loaded_summaries.size());
+        for (size_t i = 0; i < summaries.size(); ++i) {
+            EXPECT_EQ(summaries[i].total_infections, loaded_summaries[i].total_infections);
+        }
+
+        const auto &a = original.people;
+        const auto &b = loaded.people;
+        ASSERT_EQ(a.SlotCount(), b.SlotCount());
+        for (size_t i = 0; i < a.size(); ++i) {
+            auto sa = a.Slot(i);
+            auto sb = b.Slot(i);
+            ASSERT_EQ(a.hot.variant[sa], b.hot.variant[sb]);
+            ASSERT_EQ(a.hot.symptom_onset[sa], b.hot.symptom_onset[sb]);
+            ASSERT_EQ(a.hot.natural_immunity_scalar[sa], b.hot.natural_immunity_scalar[sb]);
+            ASSERT_EQ(a.Age(i), b.Age(i));
+            for (size_t v = sim::kFirstVariant; v < sim::kVariantCount; ++v) {
+                ASSERT_EQ(a.hot.natural_window[v][sa].from, b.hot.natural_window[v][sb].from);
+                ASSERT_EQ(a.hot.natural_window[v][sa].span, b.hot.natural_window[v][sb].span);
+            }
+        }
+    }
+}
+
+TEST(SnapshotTests, KeyIgnoresHistoryAfterTheLastDay) {
+    auto input = sim::test::TestInput(kSnapshotPlan);
+    auto key = sim::PopulationSnapshot::Key(*sim::CompilePlan(input), 10);
+
+    input.infected_history["XX"][19] = {500, 0};
+    EXPECT_EQ(key, sim::PopulationSnapshot::Key(*sim::CompilePlan(input), 10));
+
+    input.infected_history["XX"][5] = {51, 0};
+    EXPECT_NE(key, sim::PopulationSnapshot::Key(*sim::CompilePlan(input), 10));
+
+    input = sim::test::TestInput(kSnapshotPlan);
+    input.seed = 8;
+    EXPECT_NE(key, sim::PopulationSnapshot::Key(*sim::CompilePlan(input), 10));
+}
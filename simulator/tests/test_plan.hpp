@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "../sim/plan.hpp"
+
+namespace sim::test {
+
+    /** @brief Properties used for both variants unless a test needs something else: infectious for a few days around
+     * symptom onset, unimodal immunity curves
+     */
+    inline data::VariantProperties TestVariant() {
+        data::VariantProperties v;
+        v.incubation = {0.5, 1.0};
+        v.infectivity = {{0.0, 0.2, 0.3, 0.2, 0.1, 0.0}, 2};
+        v.natural_immunity = {{0.0, 0.2, 1.0, 1.0, 0.8, 0.6, 0.4, 0.2}, 1};
+        v.vax_immunity = {{0.0, 0.5, 0.9, 0.7, 0.3}, 0};
+        return v;
+    }
+
+    /** @brief The test variant with other immunity curves
+     */
+    inline data::VariantProperties TestVariant(data::DiscreteFunction natural, data::DiscreteFunction vax) {
+        auto v = TestVariant();
+        v.natural_immunity = std::move(natural);
+        v.vax_immunity = std::move(vax);
+        return v;
+    }
+
+    /** @brief What can be varied in the input built by TestInput. Fields are listed so that designated initializers
+     * can pick out the few a test cares about.
+     */
+    struct TestPlanOptions {
+        int population = 2000;
+        std::vector<double> ages{0.5, 0.5};
+        uint64_t seed = 7;
+        int start_day = 10;
+        int end_day = 30;
+
+        // Histories cover days [0, history_days), over which infections grow quadratically and vaccinations linearly,
+        // both in proportion to the population
+        int history_days = 40;
+        bool vaccinations = true;
+
+        data::VariantProperties variant = TestVariant();
+        data::ProgramOptions options{};
+    };
+
+    /** @brief The input of a single state "XX" with an epidemic which is alpha at first and all delta from day 20
+     */
+    inline data::ProgramInput TestInput(const TestPlanOptions &o = {}) {
+        data::ProgramInput input{};
+        input.start_day = data::ToSysDays(o.start_day);
+        input.end_day = data::ToSysDays(o.end_day);
+        input.state = "XX";
+        input.population_scale = 1;
+        input.seed = o.seed;
+        input.options = o.options;
+        input.world_properties = {o.variant, o.variant};
+        input.state_info["XX"] = {o.population, {}, o.ages};
+        for (int day = 0; day < o.history_days; ++day) {
+            input.infected_history["XX"][day] = {day * day * o.population / 2000, 0};
+            if (o.vaccinations) input.vax_history["XX"][day] = {day * 5 * o.population / 2000};
+        }
+        input.variant_history["XX"] = {{0, {{"alpha", 0.7}, {"delta", 0.3}}}, {20, {{"delta", 1.0}}}};
+        return input;
+    }
+
+    inline std::shared_ptr<const SimulationPlan> TestPlan(const TestPlanOptions &o = {}) {
+        return CompilePlan(TestInput(o));
+    }
+
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+#include "../sim/thread_pool.hpp"
+
+TEST(ThreadPoolTests, ParallelForCoversTheRangeOnce) {
+    sim::ThreadPool pool(4);
+    ASSERT_EQ(4, pool.Size());
+
+    std::vector<std::atomic<int>> visits(10000);
+    std::atomic<size_t> largest{0};
+    pool.ParallelFor(0, visits.size(), 64, [&](size_t first, size_t last) {
+        EXPECT_LT(first, last);
+        EXPECT_LT(pool.WorkerIndex(), pool.Size());
+        for (auto i = first; i < last; ++i) visits[i]++;
+
+        auto size = last - first;
+        auto seen = largest.load();
+        while (size > seen && !largest.compare_exchange_weak(seen, size)) {}
+    });
+
+    for (size_t i = 0; i < visits.size(); ++i) {
+        ASSERT_EQ(1, visits[i].load()) << i;
+    }
+    EXPECT_LE(largest.load(), 64);
+}
+
+TEST(ThreadPoolTests, LoopsNestInsideTasks) {
+    sim::ThreadPool pool(3);
+
+    // Uneven outer tasks, each running a loop of its own
+    std::vector<std::atomic<long>> sums(20);
+    pool.ParallelFor(0, sums.size(), 1, [&](size_t first, size_t last) {
+        for (auto i = first; i < last; ++i) {
+            pool.ParallelFor(0, 1000 * (i + 1), 50, [&](size_t b, size_t e) {
+                long sum = 0;
+                for (auto k = b; k < e; ++k) sum += static_cast<long>(k);
+                sums[i] += sum;
+            });
+        }
+    });
+
+    for (size_t i = 0; i < sums.size(); ++i) {
+        long n = 1000 * static_cast<long>(i + 1);
+        EXPECT_EQ(n * (n - 1) / 2, sums[i].load()) << i;
+    }
+}
+
+TEST(ThreadPoolTests, SingleThreadRunsInline) {
+    sim::ThreadPool pool(1);
+    int calls = 0;
+    pool.ParallelFor(5, 105, 10, [&](size_t first, size_t last) {
+        EXPECT_EQ(5, first);
+        EXPECT_EQ(105, last);
+        calls++;
+    });
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(0, pool.WorkerIndex());
+}
+
+TEST(ThreadPoolTests, DispatchCostIsMeasuredOnce) {
+    sim::ThreadPool single(1);
+    EXPECT_EQ(0.0, single.DispatchNanoseconds());
+
+    sim::ThreadPool pool(3);
+    auto first = pool.DispatchNanoseconds();
+    EXPECT_GT(first, 0.0);
+    EXPECT_EQ(first, pool.DispatchNanoseconds());
+}
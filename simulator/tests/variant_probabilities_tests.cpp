@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "../sim/variant_probabilities.hpp"
+#include "test_plan.hpp"
+
+TEST(VariantProbabilitiesTests, ImmunityWindowsMatchCurveEvaluation) {
+    // Natural immunity only wanes, vaccine immunity ramps up before waning
+    sim::data::DiscreteFunction natural{{1.0, 1.0, 0.9, 0.7, 0.7, 0.4, 0.2}, 2};
+    sim::data::DiscreteFunction vax{{0.0, 0.3, 0.8, 0.95, 0.95, 0.6, 0.5}, -1};
+    sim::VariantProbabilities variant(sim::test::TestVariant(natural, vax), sim::Variant::Delta);
+    ASSERT_TRUE(variant.HasNaturalWindows());
+    ASSERT_TRUE(variant.HasVaxWindows());
+
+    const auto v = sim::VariantIndex(sim::Variant::Delta);
+    sim::Probabilities prob(1, 0, 0, 0);
+    for (int trial = 0; trial < 2000; ++trial) {
+        float scalar = trial % 10 == 0 ? (float)(trial % 7) / 10.f : (float)prob.UniformScalar();
+        int start = 100 + trial % 13;
+
+        auto natural_window = variant.NaturalImmunityWindow(scalar, start);
+        auto vax_window = variant.VaxImmunityWindow(scalar, start);
+        for (int day = start - 20; day < start + 20; ++day) {
+            EXPECT_EQ(scalar <= variant.GetNaturalImmunity(day - start), natural_window.Contains(day));
+            EXPECT_EQ(scalar <= variant.GetVaxImmunity(day - start), vax_window.Contains(day));
+        }
+    }
+
+    // The check on a population member goes through the stored window
+    sim::People people;
+    people.Resize(1);
+    EXPECT_FALSE(variant.IsPersonNatImmune(people, 0, 0));
+    people.hot.natural_window[v][0] = variant.NaturalImmunityWindow(0.8f, 10);
+    EXPECT_TRUE(variant.IsPersonNatImmune(people, 0, 10));
+    EXPECT_FALSE(variant.IsPersonNatImmune(people, 0, 20));
+}
+
+TEST(VariantProbabilitiesTests, NonUnimodalCurveFallsBackToEvaluation) {
+    sim::data::DiscreteFunction natural{{1.0, 0.5, 0.9, 0.2}, 0};
+    sim::data::DiscreteFunction vax{{0.0, 0.5, 0.9}, 0};
+    sim::VariantProbabilities variant(sim::test::TestVariant(natural, vax), sim::Variant::Alpha);
+    EXPECT_FALSE(variant.HasNaturalWindows());
+    EXPECT_TRUE(variant.HasVaxWindows());
+
+    sim::People people;
+    people.Resize(1);
+    people[0].variant = sim::Variant::Alpha;
+    people[0].infected_day = 10;
+    people[0].natural_immunity_scalar = 0.7f;
+    EXPECT_TRUE(variant.IsPersonNatImmune(people, 0, 10));
+    EXPECT_FALSE(variant.IsPersonNatImmune(people, 0, 11));
+    EXPECT_TRUE(variant.IsPersonNatImmune(people, 0, 12));
+    EXPECT_FALSE(variant.IsPersonNatImmune(people, 0, 13));
+}
+
+TEST(VariantProbabilitiesTests, IncubationFollowsCumulativeDistribution) {
+    auto properties = sim::test::TestVariant({{1.0}, 0}, {{0.0}, 0});
+    properties.incubation = {0.1, 0.1, 0.5, 0.9};
+    sim::VariantProbabilities variant(properties, sim::Variant::Alpha);
+
+    // Days 0 to 3 from the cumulative values, and the remainder on day 4
+    const std::vector<double> expected{0.1, 0.0, 0.4, 0.4, 0.1};
+    sim::Probabilities prob(5, 0, 0, 0);
+    const int draws = 200000;
+    std::vector<double> uniforms(draws);
+    for (auto &u : uniforms) u = prob.UniformScalar();
+    std::vector<int> incubations(draws);
+    variant.SampleIncubations(uniforms.data(), incubations.data(), uniforms.size());
+
+    std::vector<int> counts(expected.size());
+    sim::Probabilities single(5, 0, 0, 0);
+    for (int i = 0; i < draws; ++i) {
+        ASSERT_EQ(variant.GetRandomIncubation(single), incubations[i]);
+        counts.at(incubations[i])++;
+    }
+    for (size_t day = 0; day < expected.size(); ++day) {
+        EXPECT_NEAR(expected[day], static_cast<double>(counts[day]) / draws, 0.005) << day;
+    }
+}